@@ -1,800 +1,5398 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <time.h>
-#include <math.h> // for abs()
-
-// Board dimensions and constants.
-#define EMPTY_CELL '.'
-#define BOARD_DIM 8
-#define MAX_LEGAL_MOVES 256
-
-#define SIDE_WHITE 0
-#define SIDE_BLACK 1
-
-// Global state for castling rights.
-int whiteKingMoved = 0, whiteQRookMoved = 0, whiteKRookMoved = 0;
-int blackKingMoved = 0, blackQRookMoved = 0, blackKRookMoved = 0;
-
-// Global en passant target (if any). Valid only for one move.
-int enPassantTargetRow = -1, enPassantTargetCol = -1;
-
-// Structure representing a chess move.
-typedef struct {
-    int src_row, src_col;
-    int dst_row, dst_col;
-    char promoteTo; // Nonzero if a pawn promotes (always to Queen here).
-} ChessMove;
-
-// Global board. White pieces are uppercase; Black pieces are lowercase.
-char chessBoard[BOARD_DIM][BOARD_DIM];
-
-/*
- * initialize_board:
- * Sets up the board to the standard chess starting position.
- */
-void initialize_board() {
-    // Black's back rank (row 0) and pawns (row 1)
-    chessBoard[0][0] = 'r'; chessBoard[0][1] = 'n'; chessBoard[0][2] = 'b'; chessBoard[0][3] = 'q';
-    chessBoard[0][4] = 'k'; chessBoard[0][5] = 'b'; chessBoard[0][6] = 'n'; chessBoard[0][7] = 'r';
-    for (int i = 0; i < BOARD_DIM; i++)
-        chessBoard[1][i] = 'p';
-    // Empty squares (rows 2-5)
-    for (int r = 2; r < 6; r++) {
-        for (int c = 0; c < BOARD_DIM; c++)
-            chessBoard[r][c] = EMPTY_CELL;
-    }
-    // White's pawns (row 6) and back rank (row 7)
-    for (int i = 0; i < BOARD_DIM; i++)
-        chessBoard[6][i] = 'P';
-    chessBoard[7][0] = 'R'; chessBoard[7][1] = 'N'; chessBoard[7][2] = 'B'; chessBoard[7][3] = 'Q';
-    chessBoard[7][4] = 'K'; chessBoard[7][5] = 'B'; chessBoard[7][6] = 'N'; chessBoard[7][7] = 'R';
-}
-
-/*
- * display_board:
- * Prints the board along with file (a-h) and rank (1-8) labels.
- */
-void display_board() {
-    printf("  a b c d e f g h\n");
-    for (int r = 0; r < BOARD_DIM; r++) {
-        printf("%d ", 8 - r);
-        for (int c = 0; c < BOARD_DIM; c++) {
-            printf("%c ", chessBoard[r][c]);
-        }
-        printf("\n");
-    }
-}
-
-/*
- * isPieceWhite / isPieceBlack:
- * Helper functions to determine if a piece symbol belongs to White or Black.
- */
-int isPieceWhite(char symbol) {
-    return (symbol >= 'A' && symbol <= 'Z');
-}
-
-int isPieceBlack(char symbol) {
-    return (symbol >= 'a' && symbol <= 'z');
-}
-
-/*
- * isInsideBoard:
- * Returns true if the (row, col) coordinates are within board limits.
- */
-int isInsideBoard(int row, int col) {
-    return (row >= 0 && row < BOARD_DIM && col >= 0 && col < BOARD_DIM);
-}
-
-/*
- * clone_board:
- * Copies the board state from source into dest.
- */
-void clone_board(char source[BOARD_DIM][BOARD_DIM], char dest[BOARD_DIM][BOARD_DIM]) {
-    for (int r = 0; r < BOARD_DIM; r++)
-        for (int c = 0; c < BOARD_DIM; c++)
-            dest[r][c] = source[r][c];
-}
-
-/*
- * save_state & restore_state:
- * These functions save and restore the complete game state (board, castling rights, en passant target)
- * so that we can search moves without permanently affecting the current game.
- */
-void save_state(char boardSave[BOARD_DIM][BOARD_DIM],
-    int* saveWhiteKing, int* saveWhiteQRook, int* saveWhiteKRook,
-    int* saveBlackKing, int* saveBlackQRook, int* saveBlackKRook,
-    int* saveEnPassantRow, int* saveEnPassantCol) {
-    clone_board(chessBoard, boardSave);
-    *saveWhiteKing = whiteKingMoved;
-    *saveWhiteQRook = whiteQRookMoved;
-    *saveWhiteKRook = whiteKRookMoved;
-    *saveBlackKing = blackKingMoved;
-    *saveBlackQRook = blackQRookMoved;
-    *saveBlackKRook = blackKRookMoved;
-    *saveEnPassantRow = enPassantTargetRow;
-    *saveEnPassantCol = enPassantTargetCol;
-}
-
-void restore_state(char boardSave[BOARD_DIM][BOARD_DIM],
-    int saveWhiteKing, int saveWhiteQRook, int saveWhiteKRook,
-    int saveBlackKing, int saveBlackQRook, int saveBlackKRook,
-    int saveEnPassantRow, int saveEnPassantCol) {
-    clone_board(boardSave, chessBoard);
-    whiteKingMoved = saveWhiteKing;
-    whiteQRookMoved = saveWhiteQRook;
-    whiteKRookMoved = saveWhiteKRook;
-    blackKingMoved = saveBlackKing;
-    blackQRookMoved = saveBlackQRook;
-    blackKRookMoved = saveBlackKRook;
-    enPassantTargetRow = saveEnPassantRow;
-    enPassantTargetCol = saveEnPassantCol;
-}
-
-/*
- * execute_move_on_board:
- * Applies a move to the given board state, updating castling rights, handling en passant,
- * and moving the rook when castling.
- */
-void execute_move_on_board(char boardState[BOARD_DIM][BOARD_DIM], ChessMove move) {
-    // Clear en passant target (it lasts only one move).
-    enPassantTargetRow = -1;
-    enPassantTargetCol = -1;
-
-    char pieceSymbol = boardState[move.src_row][move.src_col];
-
-    // --- Castling ---
-    if (tolower(pieceSymbol) == 'k' && abs(move.dst_col - move.src_col) == 2) {
-        boardState[move.src_row][move.src_col] = EMPTY_CELL;
-        boardState[move.dst_row][move.dst_col] = pieceSymbol;
-        // Kingside castling: move the rook from h-file.
-        if (move.dst_col > move.src_col) {
-            boardState[move.src_row][7] = EMPTY_CELL;
-            boardState[move.src_row][move.dst_col - 1] = (pieceSymbol == 'K' ? 'R' : 'r');
-        }
-        else { // Queenside castling.
-            boardState[move.src_row][0] = EMPTY_CELL;
-            boardState[move.src_row][move.dst_col + 1] = (pieceSymbol == 'K' ? 'R' : 'r');
-        }
-        // Update king's moved flag.
-        if (pieceSymbol == 'K')
-            whiteKingMoved = 1;
-        else
-            blackKingMoved = 1;
-        return;
-    }
-
-    // --- En Passant Capture ---
-    if (tolower(pieceSymbol) == 'p' &&
-        abs(move.dst_col - move.src_col) == 1 &&
-        boardState[move.dst_row][move.dst_col] == EMPTY_CELL) {
-        boardState[move.src_row][move.src_col] = EMPTY_CELL;
-        boardState[move.dst_row][move.dst_col] = pieceSymbol;
-        // Remove the pawn that just made a two-step move.
-        if (pieceSymbol == 'P')
-            boardState[move.dst_row + 1][move.dst_col] = EMPTY_CELL;
-        else
-            boardState[move.dst_row - 1][move.dst_col] = EMPTY_CELL;
-        return;
-    }
-
-    // --- Normal Move ---
-    boardState[move.src_row][move.src_col] = EMPTY_CELL;
-    if (move.promoteTo)
-        pieceSymbol = move.promoteTo;
-    boardState[move.dst_row][move.dst_col] = pieceSymbol;
-
-    // Update castling rights if a king or rook moves.
-    if (tolower(pieceSymbol) == 'k') {
-        if (pieceSymbol == 'K')
-            whiteKingMoved = 1;
-        else
-            blackKingMoved = 1;
-    }
-    if (tolower(pieceSymbol) == 'r') {
-        if (pieceSymbol == 'R') {
-            if (move.src_row == 7 && move.src_col == 0)
-                whiteQRookMoved = 1;
-            if (move.src_row == 7 && move.src_col == 7)
-                whiteKRookMoved = 1;
-        }
-        else {
-            if (move.src_row == 0 && move.src_col == 0)
-                blackQRookMoved = 1;
-            if (move.src_row == 0 && move.src_col == 7)
-                blackKRookMoved = 1;
-        }
-    }
-    // Set en passant target if a pawn moves two squares forward.
-    if (tolower(pieceSymbol) == 'p' && abs(move.dst_row - move.src_row) == 2) {
-        enPassantTargetRow = (move.src_row + move.dst_row) / 2;
-        enPassantTargetCol = move.src_col;
-    }
-}
-
-/*
- * isCellAttacked:
- * Checks whether the square at (row, col) is attacked by any enemy piece.
- * It considers pawn, knight, sliding (rook, bishop, queen), and king moves.
- */
-int isCellAttacked(char boardState[BOARD_DIM][BOARD_DIM], int row, int col, int attackerSide) {
-    // Pawn attacks.
-    if (attackerSide == SIDE_WHITE) {
-        int pawnRow = row + 1;
-        if (isInsideBoard(pawnRow, col - 1) && boardState[pawnRow][col - 1] == 'P') return 1;
-        if (isInsideBoard(pawnRow, col + 1) && boardState[pawnRow][col + 1] == 'P') return 1;
-    }
-    else {
-        int pawnRow = row - 1;
-        if (isInsideBoard(pawnRow, col - 1) && boardState[pawnRow][col - 1] == 'p') return 1;
-        if (isInsideBoard(pawnRow, col + 1) && boardState[pawnRow][col + 1] == 'p') return 1;
-    }
-    // Knight moves.
-    int knightOffsets[8][2] = { {-2,-1}, {-2,1}, {-1,-2}, {-1,2},
-                                {1,-2}, {1,2}, {2,-1}, {2,1} };
-    for (int i = 0; i < 8; i++) {
-        int newRow = row + knightOffsets[i][0];
-        int newCol = col + knightOffsets[i][1];
-        if (isInsideBoard(newRow, newCol)) {
-            char piece = boardState[newRow][newCol];
-            if (attackerSide == SIDE_WHITE && piece == 'N') return 1;
-            if (attackerSide == SIDE_BLACK && piece == 'n') return 1;
-        }
-    }
-    // Rook/Queen linear moves.
-    int linearDirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
-    for (int d = 0; d < 4; d++) {
-        int dRow = linearDirs[d][0], dCol = linearDirs[d][1];
-        int newRow = row + dRow, newCol = col + dCol;
-        while (isInsideBoard(newRow, newCol)) {
-            char piece = boardState[newRow][newCol];
-            if (piece != EMPTY_CELL) {
-                if (attackerSide == SIDE_WHITE) {
-                    if (piece == 'R' || piece == 'Q')
-                        return 1;
-                }
-                else {
-                    if (piece == 'r' || piece == 'q')
-                        return 1;
-                }
-                break;
-            }
-            newRow += dRow;
-            newCol += dCol;
-        }
-    }
-    // Bishop/Queen diagonal moves.
-    int diagDirs[4][2] = { {1,1}, {1,-1}, {-1,1}, {-1,-1} };
-    for (int d = 0; d < 4; d++) {
-        int dRow = diagDirs[d][0], dCol = diagDirs[d][1];
-        int newRow = row + dRow, newCol = col + dCol;
-        while (isInsideBoard(newRow, newCol)) {
-            char piece = boardState[newRow][newCol];
-            if (piece != EMPTY_CELL) {
-                if (attackerSide == SIDE_WHITE) {
-                    if (piece == 'B' || piece == 'Q')
-                        return 1;
-                }
-                else {
-                    if (piece == 'b' || piece == 'q')
-                        return 1;
-                }
-                break;
-            }
-            newRow += dRow;
-            newCol += dCol;
-        }
-    }
-    // King adjacent attack.
-    for (int dr = -1; dr <= 1; dr++) {
-        for (int dc = -1; dc <= 1; dc++) {
-            if (dr == 0 && dc == 0) continue;
-            int newRow = row + dr, newCol = col + dc;
-            if (isInsideBoard(newRow, newCol)) {
-                char piece = boardState[newRow][newCol];
-                if (attackerSide == SIDE_WHITE && piece == 'K') return 1;
-                if (attackerSide == SIDE_BLACK && piece == 'k') return 1;
-            }
-        }
-    }
-    return 0;
-}
-
-/*
- * isKingInCheck:
- * Determines if the king for the given side is in check.
- */
-int isKingInCheck(char boardState[BOARD_DIM][BOARD_DIM], int side) {
-    char kingSymbol = (side == SIDE_WHITE) ? 'K' : 'k';
-    int kingRow = -1, kingCol = -1;
-    for (int r = 0; r < BOARD_DIM; r++) {
-        for (int c = 0; c < BOARD_DIM; c++) {
-            if (boardState[r][c] == kingSymbol) {
-                kingRow = r;
-                kingCol = c;
-                break;
-            }
-        }
-        if (kingRow != -1) break;
-    }
-    if (kingRow == -1) return 1; // Missing king => consider it in check.
-    int opponent = (side == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
-    return isCellAttacked(boardState, kingRow, kingCol, opponent);
-}
-
-/*
- * generateLegalMoves:
- * Generates all legal moves for the current side. It includes normal moves, pawn moves
- * (with double moves, en passant, and promotions), as well as castling moves.
- */
-int generateLegalMoves(int side, ChessMove movesList[]) {
-    int moveCount = 0;
-    for (int r = 0; r < BOARD_DIM; r++) {
-        for (int c = 0; c < BOARD_DIM; c++) {
-            char currentPiece = chessBoard[r][c];
-            if (currentPiece == EMPTY_CELL) continue;
-            int pieceSide = isPieceWhite(currentPiece) ? SIDE_WHITE : SIDE_BLACK;
-            if (pieceSide != side) continue;
-            char lowerPiece = tolower(currentPiece);
-            if (lowerPiece == 'p') {
-                int direction = (side == SIDE_WHITE) ? -1 : 1;
-                int startRow = (side == SIDE_WHITE) ? 6 : 1;
-                int promotionRow = (side == SIDE_WHITE) ? 0 : 7;
-                int nextRow = r + direction;
-                // Single square forward.
-                if (isInsideBoard(nextRow, c) && chessBoard[nextRow][c] == EMPTY_CELL) {
-                    ChessMove mv;
-                    mv.src_row = r; mv.src_col = c;
-                    mv.dst_row = nextRow; mv.dst_col = c;
-                    mv.promoteTo = (nextRow == promotionRow) ? ((side == SIDE_WHITE) ? 'Q' : 'q') : 0;
-                    char boardCopy[BOARD_DIM][BOARD_DIM];
-                    clone_board(chessBoard, boardCopy);
-                    execute_move_on_board(boardCopy, mv);
-                    if (!isKingInCheck(boardCopy, side))
-                        movesList[moveCount++] = mv;
-                    // Two-square move.
-                    if (r == startRow && chessBoard[r + direction][c] == EMPTY_CELL &&
-                        isInsideBoard(r + 2 * direction, c) && chessBoard[r + 2 * direction][c] == EMPTY_CELL) {
-                        mv.dst_row = r + 2 * direction;
-                        mv.promoteTo = 0;
-                        clone_board(chessBoard, boardCopy);
-                        execute_move_on_board(boardCopy, mv);
-                        if (!isKingInCheck(boardCopy, side))
-                            movesList[moveCount++] = mv;
-                    }
-                }
-                // Pawn captures.
-                for (int dc = -1; dc <= 1; dc += 2) {
-                    int captureCol = c + dc;
-                    if (isInsideBoard(nextRow, captureCol) && chessBoard[nextRow][captureCol] != EMPTY_CELL) {
-                        char target = chessBoard[nextRow][captureCol];
-                        if ((side == SIDE_WHITE && isPieceBlack(target)) ||
-                            (side == SIDE_BLACK && isPieceWhite(target))) {
-                            ChessMove mv;
-                            mv.src_row = r; mv.src_col = c;
-                            mv.dst_row = nextRow; mv.dst_col = captureCol;
-                            mv.promoteTo = (nextRow == promotionRow) ? ((side == SIDE_WHITE) ? 'Q' : 'q') : 0;
-                            char boardCopy[BOARD_DIM][BOARD_DIM];
-                            clone_board(chessBoard, boardCopy);
-                            execute_move_on_board(boardCopy, mv);
-                            if (!isKingInCheck(boardCopy, side))
-                                movesList[moveCount++] = mv;
-                        }
-                    }
-                }
-                // En passant capture.
-                if (enPassantTargetRow != -1 && enPassantTargetCol != -1) {
-                    for (int dc = -1; dc <= 1; dc += 2) {
-                        if (c + dc == enPassantTargetCol && nextRow == enPassantTargetRow) {
-                            ChessMove mv;
-                            mv.src_row = r; mv.src_col = c;
-                            mv.dst_row = nextRow; mv.dst_col = c + dc;
-                            mv.promoteTo = (nextRow == promotionRow) ? ((side == SIDE_WHITE) ? 'Q' : 'q') : 0;
-                            char boardCopy[BOARD_DIM][BOARD_DIM];
-                            clone_board(chessBoard, boardCopy);
-                            execute_move_on_board(boardCopy, mv);
-                            if (!isKingInCheck(boardCopy, side))
-                                movesList[moveCount++] = mv;
-                        }
-                    }
-                }
-            }
-            else if (lowerPiece == 'n') {
-                int knightJumps[8][2] = { {-2,-1}, {-2,1}, {-1,-2}, {-1,2},
-                                          {1,-2}, {1,2}, {2,-1}, {2,1} };
-                for (int i = 0; i < 8; i++) {
-                    int newRow = r + knightJumps[i][0];
-                    int newCol = c + knightJumps[i][1];
-                    if (!isInsideBoard(newRow, newCol)) continue;
-                    char target = chessBoard[newRow][newCol];
-                    if (target == EMPTY_CELL ||
-                        (side == SIDE_WHITE && isPieceBlack(target)) ||
-                        (side == SIDE_BLACK && isPieceWhite(target))) {
-                        ChessMove mv;
-                        mv.src_row = r; mv.src_col = c;
-                        mv.dst_row = newRow; mv.dst_col = newCol;
-                        mv.promoteTo = 0;
-                        char boardCopy[BOARD_DIM][BOARD_DIM];
-                        clone_board(chessBoard, boardCopy);
-                        execute_move_on_board(boardCopy, mv);
-                        if (!isKingInCheck(boardCopy, side))
-                            movesList[moveCount++] = mv;
-                    }
-                }
-            }
-            else if (lowerPiece == 'b' || lowerPiece == 'r' || lowerPiece == 'q') {
-                int directions[8][2];
-                int numDirs = 0;
-                if (lowerPiece == 'b') {
-                    int bishopDirs[4][2] = { {1,1}, {1,-1}, {-1,1}, {-1,-1} };
-                    for (int i = 0; i < 4; i++) {
-                        directions[numDirs][0] = bishopDirs[i][0];
-                        directions[numDirs][1] = bishopDirs[i][1];
-                        numDirs++;
-                    }
-                }
-                else if (lowerPiece == 'r') {
-                    int rookDirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
-                    for (int i = 0; i < 4; i++) {
-                        directions[numDirs][0] = rookDirs[i][0];
-                        directions[numDirs][1] = rookDirs[i][1];
-                        numDirs++;
-                    }
-                }
-                else if (lowerPiece == 'q') {
-                    int queenDirs[8][2] = { {1,0}, {-1,0}, {0,1}, {0,-1},
-                                            {1,1}, {1,-1}, {-1,1}, {-1,-1} };
-                    for (int i = 0; i < 8; i++) {
-                        directions[numDirs][0] = queenDirs[i][0];
-                        directions[numDirs][1] = queenDirs[i][1];
-                        numDirs++;
-                    }
-                }
-                for (int d = 0; d < numDirs; d++) {
-                    int dRow = directions[d][0], dCol = directions[d][1];
-                    int newRow = r + dRow, newCol = c + dCol;
-                    while (isInsideBoard(newRow, newCol)) {
-                        char target = chessBoard[newRow][newCol];
-                        if (target == EMPTY_CELL) {
-                            ChessMove mv;
-                            mv.src_row = r; mv.src_col = c;
-                            mv.dst_row = newRow; mv.dst_col = newCol;
-                            mv.promoteTo = 0;
-                            char boardCopy[BOARD_DIM][BOARD_DIM];
-                            clone_board(chessBoard, boardCopy);
-                            execute_move_on_board(boardCopy, mv);
-                            if (!isKingInCheck(boardCopy, side))
-                                movesList[moveCount++] = mv;
-                        }
-                        else {
-                            if ((side == SIDE_WHITE && isPieceBlack(target)) ||
-                                (side == SIDE_BLACK && isPieceWhite(target))) {
-                                ChessMove mv;
-                                mv.src_row = r; mv.src_col = c;
-                                mv.dst_row = newRow; mv.dst_col = newCol;
-                                mv.promoteTo = 0;
-                                char boardCopy[BOARD_DIM][BOARD_DIM];
-                                clone_board(chessBoard, boardCopy);
-                                execute_move_on_board(boardCopy, mv);
-                                if (!isKingInCheck(boardCopy, side))
-                                    movesList[moveCount++] = mv;
-                            }
-                            break;
-                        }
-                        newRow += dRow;
-                        newCol += dCol;
-                    }
-                }
-            }
-            else if (lowerPiece == 'k') {
-                // King moves (one square in any direction).
-                for (int dr = -1; dr <= 1; dr++) {
-                    for (int dc = -1; dc <= 1; dc++) {
-                        if (dr == 0 && dc == 0) continue;
-                        int newRow = r + dr, newCol = c + dc;
-                        if (!isInsideBoard(newRow, newCol)) continue;
-                        char target = chessBoard[newRow][newCol];
-                        if (target == EMPTY_CELL ||
-                            (side == SIDE_WHITE && isPieceBlack(target)) ||
-                            (side == SIDE_BLACK && isPieceWhite(target))) {
-                            ChessMove mv;
-                            mv.src_row = r; mv.src_col = c;
-                            mv.dst_row = newRow; mv.dst_col = newCol;
-                            mv.promoteTo = 0;
-                            char boardCopy[BOARD_DIM][BOARD_DIM];
-                            clone_board(chessBoard, boardCopy);
-                            execute_move_on_board(boardCopy, mv);
-                            if (!isKingInCheck(boardCopy, side))
-                                movesList[moveCount++] = mv;
-                        }
-                    }
-                }
-                // --- Castling Moves ---
-                if (side == SIDE_WHITE && r == 7 && c == 4 && !whiteKingMoved) {
-                    // White kingside castling.
-                    if (!whiteKRookMoved && chessBoard[7][7] == 'R' &&
-                        chessBoard[7][5] == EMPTY_CELL && chessBoard[7][6] == EMPTY_CELL &&
-                        !isCellAttacked(chessBoard, 7, 4, SIDE_BLACK) &&
-                        !isCellAttacked(chessBoard, 7, 5, SIDE_BLACK) &&
-                        !isCellAttacked(chessBoard, 7, 6, SIDE_BLACK)) {
-                        ChessMove mv;
-                        mv.src_row = 7; mv.src_col = 4;
-                        mv.dst_row = 7; mv.dst_col = 6;
-                        mv.promoteTo = 0;
-                        char boardCopy[BOARD_DIM][BOARD_DIM];
-                        clone_board(chessBoard, boardCopy);
-                        execute_move_on_board(boardCopy, mv);
-                        if (!isKingInCheck(boardCopy, SIDE_WHITE))
-                            movesList[moveCount++] = mv;
-                    }
-                    // White queenside castling.
-                    if (!whiteQRookMoved && chessBoard[7][0] == 'R' &&
-                        chessBoard[7][1] == EMPTY_CELL && chessBoard[7][2] == EMPTY_CELL && chessBoard[7][3] == EMPTY_CELL &&
-                        !isCellAttacked(chessBoard, 7, 4, SIDE_BLACK) &&
-                        !isCellAttacked(chessBoard, 7, 3, SIDE_BLACK) &&
-                        !isCellAttacked(chessBoard, 7, 2, SIDE_BLACK)) {
-                        ChessMove mv;
-                        mv.src_row = 7; mv.src_col = 4;
-                        mv.dst_row = 7; mv.dst_col = 2;
-                        mv.promoteTo = 0;
-                        char boardCopy[BOARD_DIM][BOARD_DIM];
-                        clone_board(chessBoard, boardCopy);
-                        execute_move_on_board(boardCopy, mv);
-                        if (!isKingInCheck(boardCopy, SIDE_WHITE))
-                            movesList[moveCount++] = mv;
-                    }
-                }
-                else if (side == SIDE_BLACK && r == 0 && c == 4 && !blackKingMoved) {
-                    // Black kingside castling.
-                    if (!blackKRookMoved && chessBoard[0][7] == 'r' &&
-                        chessBoard[0][5] == EMPTY_CELL && chessBoard[0][6] == EMPTY_CELL &&
-                        !isCellAttacked(chessBoard, 0, 4, SIDE_WHITE) &&
-                        !isCellAttacked(chessBoard, 0, 5, SIDE_WHITE) &&
-                        !isCellAttacked(chessBoard, 0, 6, SIDE_WHITE)) {
-                        ChessMove mv;
-                        mv.src_row = 0; mv.src_col = 4;
-                        mv.dst_row = 0; mv.dst_col = 6;
-                        mv.promoteTo = 0;
-                        char boardCopy[BOARD_DIM][BOARD_DIM];
-                        clone_board(chessBoard, boardCopy);
-                        execute_move_on_board(boardCopy, mv);
-                        if (!isKingInCheck(boardCopy, SIDE_BLACK))
-                            movesList[moveCount++] = mv;
-                    }
-                    // Black queenside castling.
-                    if (!blackQRookMoved && chessBoard[0][0] == 'r' &&
-                        chessBoard[0][1] == EMPTY_CELL && chessBoard[0][2] == EMPTY_CELL && chessBoard[0][3] == EMPTY_CELL &&
-                        !isCellAttacked(chessBoard, 0, 4, SIDE_WHITE) &&
-                        !isCellAttacked(chessBoard, 0, 3, SIDE_WHITE) &&
-                        !isCellAttacked(chessBoard, 0, 2, SIDE_WHITE)) {
-                        ChessMove mv;
-                        mv.src_row = 0; mv.src_col = 4;
-                        mv.dst_row = 0; mv.dst_col = 2;
-                        mv.promoteTo = 0;
-                        char boardCopy[BOARD_DIM][BOARD_DIM];
-                        clone_board(chessBoard, boardCopy);
-                        execute_move_on_board(boardCopy, mv);
-                        if (!isKingInCheck(boardCopy, SIDE_BLACK))
-                            movesList[moveCount++] = mv;
-                    }
-                }
-            }
-        }
-    }
-    return moveCount;
-}
-
-/*
- * output_move:
- * Converts a ChessMove to standard coordinate notation (e.g., "e2e4") and prints it.
- * Promotions append "=Q" (or "=q").
- */
-void output_move(ChessMove move) {
-    char srcFile = 'a' + move.src_col;
-    char srcRank = '8' - move.src_row;
-    char dstFile = 'a' + move.dst_col;
-    char dstRank = '8' - move.dst_row;
-    printf("%c%c%c%c", srcFile, srcRank, dstFile, dstRank);
-    if (move.promoteTo)
-        printf("=%c", move.promoteTo);
-}
-
-/*
- * interpret_move:
- * Parses a move string (e.g., "e2e4" or "e7e8=Q") into a ChessMove structure.
- * It also performs basic validation.
- */
-int interpret_move(char* input, ChessMove* move, int side) {
-    if (strlen(input) < 4) return 0;
-    move->src_col = input[0] - 'a';
-    move->src_row = '8' - input[1];
-    move->dst_col = input[2] - 'a';
-    move->dst_row = '8' - input[3];
-    move->promoteTo = 0;
-    if (strlen(input) >= 6 && input[4] == '=')
-        move->promoteTo = input[5];
-    if (!isInsideBoard(move->src_row, move->src_col) || !isInsideBoard(move->dst_row, move->dst_col))
-        return 0;
-    char piece = chessBoard[move->src_row][move->src_col];
-    if (piece == EMPTY_CELL) return 0;
-    if (side == SIDE_WHITE && !isPieceWhite(piece)) return 0;
-    if (side == SIDE_BLACK && !isPieceBlack(piece)) return 0;
-    return 1;
-}
-
-/*
- * evaluate_board:
- * A simple evaluation function based solely on material count.
- * Piece values: Pawn=100, Knight=320, Bishop=330, Rook=500, Queen=900, King=20000.
- */
-int evaluate_board() {
-    int score = 0;
-    for (int r = 0; r < BOARD_DIM; r++) {
-        for (int c = 0; c < BOARD_DIM; c++) {
-            char piece = chessBoard[r][c];
-            if (piece == EMPTY_CELL) continue;
-            int pieceValue = 0;
-            switch (tolower(piece)) {
-            case 'p': pieceValue = 100; break;
-            case 'n': pieceValue = 320; break;
-            case 'b': pieceValue = 330; break;
-            case 'r': pieceValue = 500; break;
-            case 'q': pieceValue = 900; break;
-            case 'k': pieceValue = 20000; break;
-            }
-            if (isPieceWhite(piece))
-                score += pieceValue;
-            else
-                score -= pieceValue;
-        }
-    }
-    return score;
-}
-
-/*
- * minimax:
- * A simple minimax search with alpha-beta pruning.
- * It recursively evaluates positions to a specified depth and returns an evaluation score.
- */
-int minimax(int depth, int side, int alpha, int beta) {
-    if (depth == 0) return evaluate_board();
-
-    ChessMove movesList[MAX_LEGAL_MOVES];
-    int numMoves = generateLegalMoves(side, movesList);
-    if (numMoves == 0) {
-        // No moves: checkmate if king is in check, stalemate otherwise.
-        if (isKingInCheck(chessBoard, side))
-            return -20000;
-        else
-            return 0;
-    }
-
-    int bestScore = -1000000;
-    char boardSave[BOARD_DIM][BOARD_DIM];
-    int saveWhiteKing, saveWhiteQRook, saveWhiteKRook, saveBlackKing, saveBlackQRook, saveBlackKRook, saveEnPassantRow, saveEnPassantCol;
-
-    for (int i = 0; i < numMoves; i++) {
-        save_state(boardSave, &saveWhiteKing, &saveWhiteQRook, &saveWhiteKRook,
-            &saveBlackKing, &saveBlackQRook, &saveBlackKRook,
-            &saveEnPassantRow, &saveEnPassantCol);
-        execute_move_on_board(chessBoard, movesList[i]);
-        int score = -minimax(depth - 1, (side == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE, -beta, -alpha);
-        restore_state(boardSave, saveWhiteKing, saveWhiteQRook, saveWhiteKRook,
-            saveBlackKing, saveBlackQRook, saveBlackKRook,
-            saveEnPassantRow, saveEnPassantCol);
-        if (score > bestScore)
-            bestScore = score;
-        if (bestScore > alpha)
-            alpha = bestScore;
-        if (alpha >= beta)
-            break;
-    }
-    return bestScore;
-}
-
-/*
- * choose_best_move:
- * Iterates through all legal moves and uses minimax to pick the best move.
- * This is our AI decision function, set to search a given depth.
- */
-ChessMove choose_best_move(int side, int depth) {
-    ChessMove movesList[MAX_LEGAL_MOVES];
-    int numMoves = generateLegalMoves(side, movesList);
-    ChessMove bestMove = movesList[0];
-    int bestScore = -1000000;
-    char boardSave[BOARD_DIM][BOARD_DIM];
-    int saveWhiteKing, saveWhiteQRook, saveWhiteKRook, saveBlackKing, saveBlackQRook, saveBlackKRook, saveEnPassantRow, saveEnPassantCol;
-
-    for (int i = 0; i < numMoves; i++) {
-        save_state(boardSave, &saveWhiteKing, &saveWhiteQRook, &saveWhiteKRook,
-            &saveBlackKing, &saveBlackQRook, &saveBlackKRook,
-            &saveEnPassantRow, &saveEnPassantCol);
-        execute_move_on_board(chessBoard, movesList[i]);
-        int score = -minimax(depth - 1, (side == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE, -1000000, 1000000);
-        restore_state(boardSave, saveWhiteKing, saveWhiteQRook, saveWhiteKRook,
-            saveBlackKing, saveBlackQRook, saveBlackKRook,
-            saveEnPassantRow, saveEnPassantCol);
-        if (score > bestScore) {
-            bestScore = score;
-            bestMove = movesList[i];
-        }
-    }
-    return bestMove;
-}
-
-/*
- * main:
- * The main game loop. The human (White) inputs moves in coordinate notation,
- * and the AI (Black) now uses a minimax search to choose its move.
- *
- * For castling, enter:
- *   - Kingside as "e1g1" (for White) or "e8g8" (for Black)
- *   - Queenside as "e1c1" or "e8c8"
- */
-int main() {
-    initialize_board();
-    srand(time(NULL));
-
-    // Reset global state.
-    whiteKingMoved = whiteQRookMoved = whiteKRookMoved = 0;
-    blackKingMoved = blackQRookMoved = blackKRookMoved = 0;
-    enPassantTargetRow = -1;
-    enPassantTargetCol = -1;
-
-    int activeSide = SIDE_WHITE;
-    int searchDepth = 3;  // Adjust search depth for AI (depth 3 gives beginner-intermediate strength)
-
-    while (1) {
-        display_board();
-        ChessMove legalMoves[MAX_LEGAL_MOVES];
-        int numLegal = generateLegalMoves(activeSide, legalMoves);
-        if (numLegal == 0) {
-            if (isKingInCheck(chessBoard, activeSide))
-                printf("%s is checkmated. %s wins!\n",
-                    (activeSide == SIDE_WHITE ? "White" : "Black"),
-                    (activeSide == SIDE_WHITE ? "Black" : "White"));
-            else
-                printf("Stalemate!\n");
-            break;
-        }
-        if (activeSide == SIDE_WHITE) {
-            // Human move.
-            printf("Enter your move (e.g., e2e4): ");
-            char inputStr[10];
-            fgets(inputStr, sizeof(inputStr), stdin);
-            inputStr[strcspn(inputStr, "\n")] = 0;
-            ChessMove playerMove;
-            if (!interpret_move(inputStr, &playerMove, SIDE_WHITE)) {
-                printf("Invalid move format.\n");
-                continue;
-            }
-            int valid = 0;
-            for (int i = 0; i < numLegal; i++) {
-                if (legalMoves[i].src_row == playerMove.src_row &&
-                    legalMoves[i].src_col == playerMove.src_col &&
-                    legalMoves[i].dst_row == playerMove.dst_row &&
-                    legalMoves[i].dst_col == playerMove.dst_col &&
-                    legalMoves[i].promoteTo == playerMove.promoteTo) {
-                    valid = 1;
-                    break;
-                }
-            }
-            if (!valid) {
-                printf("Illegal move. Try again.\n");
-                continue;
-            }
-            execute_move_on_board(chessBoard, playerMove);
-        }
-        else {
-            // AI move.
-            ChessMove aiMove = choose_best_move(SIDE_BLACK, searchDepth);
-            printf("AI plays: ");
-            output_move(aiMove);
-            printf("\n");
-            execute_move_on_board(chessBoard, aiMove);
-        }
-        activeSide = (activeSide == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
-    }
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h> // for abs()
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Board dimensions and constants.
+#define EMPTY_CELL '.'
+#define BOARD_DIM 8
+#define BOARD_SQUARES 64
+#define MAX_LEGAL_MOVES 256
+
+// Search scores. Mates are scored MATE_SCORE minus the distance in plies from the root.
+#define INFINITE_SCORE 1000000
+#define MATE_SCORE 30000
+#define MATE_BOUND (MATE_SCORE - 1000)
+#define DRAW_SCORE 0
+#define FIFTY_MOVE_PLIES 100   // Halfmoves without a capture or pawn move that draw the game.
+
+// Deepest line the search will follow from the root.
+#define MAX_PLY 64
+
+#define SIDE_WHITE 0
+#define SIDE_BLACK 1
+#define NO_SIDE 2
+
+// A side as a template argument: the hot paths are instantiated once per side, so
+// "which way do pawns move" and "who is the enemy" become compile-time constants.
+typedef int Color;
+
+// Piece types, used to index the per-type bitboards.
+#define PAWN 0
+#define KNIGHT 1
+#define BISHOP 2
+#define ROOK 3
+#define QUEEN 4
+#define KING 5
+#define PIECE_TYPES 6
+
+// Squares are numbered row-major from a8 (0) to h1 (63), matching the board array.
+#define SQUARE_OF(row, col) ((row) * BOARD_DIM + (col))
+#define ROW_OF(square) ((square) >> 3)
+#define COL_OF(square) ((square) & 7)
+#define SQUARE_BB(square) (1ULL << (square))
+#define ROW_BB(row) (0xFFULL << (8 * (row)))
+
+typedef unsigned long long Bitboard;
+typedef unsigned long long HashKey;
+
+// Castling rights, one bit per side and wing.
+#define CASTLE_WHITE_KING 1
+#define CASTLE_WHITE_QUEEN 2
+#define CASTLE_BLACK_KING 4
+#define CASTLE_BLACK_QUEEN 8
+#define CASTLE_ALL 15
+
+// Longest line of moves the undo stack can hold.
+#define MAX_UNDO 1024
+
+// Structure representing a chess move.
+typedef struct {
+    int src_row, src_col;
+    int dst_row, dst_col;
+    char promoteTo; // Nonzero if a pawn promotes (uppercase for White, lowercase for Black).
+} ChessMove;
+
+// What make_move changed, so unmake_move can put it back without copying the board.
+typedef struct {
+    ChessMove move;
+    char captured;        // Piece taken on the destination (or by en passant), EMPTY_CELL if none.
+    int castlingRights;   // Rights before the move.
+    int enPassantSquare;  // En passant target before the move.
+    int halfmoveClock;    // Fifty-move counter before the move.
+    HashKey key;          // Position key before the move.
+} UndoInfo;
+
+// Board state. The character array is kept for display and square lookups, and the
+// bitboards (one per piece type and color, plus occupancy) are kept in sync with it.
+typedef struct {
+    char squares[BOARD_DIM][BOARD_DIM];
+    Bitboard pieces[2][PIECE_TYPES];
+    Bitboard occupancy[2];
+    Bitboard occupied;
+} BoardState;
+
+// A complete game state. Everything that move generation, evaluation and search read or
+// write lives here, so independent positions can be searched side by side.
+typedef struct {
+    BoardState board;       // White pieces are uppercase; Black pieces are lowercase.
+    int sideToMove;
+    int castlingRights;
+    int enPassantSquare;    // En passant target square (if any, -1 otherwise). Valid only for one move.
+    int halfmoveClock;      // Plies since the last capture or pawn move.
+    int fullmoveNumber;
+    HashKey key;            // Zobrist key, updated incrementally as moves are made.
+    HashKey pawnKey;        // Zobrist key of the pawns alone, for the pawn hash.
+    int mgScore, egScore;   // Material plus piece-square sums from White's view, middlegame and endgame.
+    int phase;              // Game phase from the remaining pieces, 24 at the start.
+    UndoInfo undoStack[MAX_UNDO]; // Moves made with make_move, most recent last.
+    int undoCount;
+} Position;
+
+// Zobrist keys: one per piece and square, plus side to move, castling rights and en passant file.
+HashKey zobristPieces[2][PIECE_TYPES][BOARD_SQUARES];
+HashKey zobristCastling[16];
+HashKey zobristEnPassant[BOARD_DIM];
+HashKey zobristBlackToMove;
+
+// Material plus piece-square value of each piece on each square from White's view
+// (negative for Black), for the middlegame and the endgame. Filled by init_eval_tables.
+int pieceSquareMg[2][PIECE_TYPES][BOARD_SQUARES];
+int pieceSquareEg[2][PIECE_TYPES][BOARD_SQUARES];
+
+// Phase contributed by each piece type; the starting position adds up to TOTAL_PHASE.
+#define TOTAL_PHASE 24
+static const int phaseWeights[PIECE_TYPES] = { 0, 1, 1, 2, 4, 0 };
+
+/*
+ * lsb_index / pop_lsb / popcount:
+ * Bit-twiddling helpers for walking bitboards.
+ */
+#if defined(_MSC_VER)
+#include <intrin.h>
+static inline int lsb_index(Bitboard b) {
+    unsigned long index;
+    _BitScanForward64(&index, b);
+    return (int)index;
+}
+static inline int popcount(Bitboard b) {
+    return (int)__popcnt64(b);
+}
+#else
+static inline int lsb_index(Bitboard b) {
+    return __builtin_ctzll(b);
+}
+static inline int popcount(Bitboard b) {
+    return __builtin_popcountll(b);
+}
+#endif
+
+static inline int pop_lsb(Bitboard* b) {
+    int square = lsb_index(*b);
+    *b &= *b - 1;
+    return square;
+}
+
+/*
+ * Piece code tables:
+ * Side and type of every piece symbol, built at compile time and indexed by the symbol,
+ * so the board array can be read without character tests. Anything that is not a piece
+ * has no side and, as the old switch did, maps to KING.
+ */
+typedef struct {
+    signed char side[128];
+    signed char type[128];
+} PieceCodes;
+
+static constexpr PieceCodes make_piece_codes() {
+    PieceCodes codes = {};
+    for (int symbol = 0; symbol < 128; symbol++) {
+        codes.side[symbol] = NO_SIDE;
+        codes.type[symbol] = KING;
+    }
+    const char* symbols = "PNBRQK";
+    for (int type = PAWN; type <= KING; type++) {
+        codes.side[(int)symbols[type]] = SIDE_WHITE;
+        codes.side[symbols[type] - 'A' + 'a'] = SIDE_BLACK;
+        codes.type[(int)symbols[type]] = (signed char)type;
+        codes.type[symbols[type] - 'A' + 'a'] = (signed char)type;
+    }
+    return codes;
+}
+
+static constexpr PieceCodes pieceCodes = make_piece_codes();
+
+// Symbol of each piece type for each side.
+static constexpr char pieceSymbols[2][PIECE_TYPES] = { { 'P', 'N', 'B', 'R', 'Q', 'K' }, { 'p', 'n', 'b', 'r', 'q', 'k' } };
+
+/*
+ * isPieceWhite / isPieceBlack / pieceSideOf:
+ * Helper functions to determine if a piece symbol belongs to White or Black.
+ */
+static inline int pieceSideOf(char symbol) {
+    return pieceCodes.side[symbol & 127];
+}
+
+static inline int isPieceWhite(char symbol) {
+    return pieceSideOf(symbol) == SIDE_WHITE;
+}
+
+static inline int isPieceBlack(char symbol) {
+    return pieceSideOf(symbol) == SIDE_BLACK;
+}
+
+/*
+ * pieceTypeOf:
+ * Maps a piece symbol to its piece type index (PAWN..KING).
+ */
+static inline int pieceTypeOf(char symbol) {
+    return pieceCodes.type[symbol & 127];
+}
+
+/*
+ * isInsideBoard:
+ * Returns true if the (row, col) coordinates are within board limits.
+ */
+int isInsideBoard(int row, int col) {
+    return (row >= 0 && row < BOARD_DIM && col >= 0 && col < BOARD_DIM);
+}
+
+/*
+ * put_piece / remove_piece:
+ * Place or clear a piece on a square, keeping the bitboards and the position key
+ * in step with the array.
+ */
+void put_piece(Position* pos, int square, char symbol) {
+    BoardState* boardState = &pos->board;
+    int side = pieceSideOf(symbol);
+    int type = pieceTypeOf(symbol);
+    Bitboard bit = SQUARE_BB(square);
+    boardState->squares[ROW_OF(square)][COL_OF(square)] = symbol;
+    boardState->pieces[side][type] |= bit;
+    boardState->occupancy[side] |= bit;
+    boardState->occupied |= bit;
+    pos->key ^= zobristPieces[side][type][square];
+    if (type == PAWN)
+        pos->pawnKey ^= zobristPieces[side][type][square];
+    pos->mgScore += pieceSquareMg[side][type][square];
+    pos->egScore += pieceSquareEg[side][type][square];
+    pos->phase += phaseWeights[type];
+}
+
+void remove_piece(Position* pos, int square) {
+    BoardState* boardState = &pos->board;
+    char symbol = boardState->squares[ROW_OF(square)][COL_OF(square)];
+    if (symbol == EMPTY_CELL) return;
+    int side = pieceSideOf(symbol);
+    int type = pieceTypeOf(symbol);
+    Bitboard bit = SQUARE_BB(square);
+    boardState->squares[ROW_OF(square)][COL_OF(square)] = EMPTY_CELL;
+    boardState->pieces[side][type] &= ~bit;
+    boardState->occupancy[side] &= ~bit;
+    boardState->occupied &= ~bit;
+    pos->key ^= zobristPieces[side][type][square];
+    if (type == PAWN)
+        pos->pawnKey ^= zobristPieces[side][type][square];
+    pos->mgScore -= pieceSquareMg[side][type][square];
+    pos->egScore -= pieceSquareEg[side][type][square];
+    pos->phase -= phaseWeights[type];
+}
+
+/*
+ * clear_board:
+ * Empties every square and bitboard and resets the position keys and evaluation sums.
+ */
+void clear_board(Position* pos) {
+    memset(&pos->board, 0, sizeof(pos->board));
+    memset(pos->board.squares, EMPTY_CELL, sizeof(pos->board.squares));
+    pos->key = 0;
+    pos->pawnKey = 0;
+    pos->mgScore = pos->egScore = 0;
+    pos->phase = 0;
+}
+
+/*
+ * initialize_board:
+ * Sets up the position to the standard chess starting position, White to move.
+ */
+void initialize_board(Position* pos) {
+    const char* backRank = "rnbqkbnr";
+    clear_board(pos);
+    // Black's back rank (row 0) and pawns (row 1)
+    for (int i = 0; i < BOARD_DIM; i++) {
+        put_piece(pos, SQUARE_OF(0, i), backRank[i]);
+        put_piece(pos, SQUARE_OF(1, i), 'p');
+    }
+    // White's pawns (row 6) and back rank (row 7)
+    for (int i = 0; i < BOARD_DIM; i++) {
+        put_piece(pos, SQUARE_OF(6, i), 'P');
+        put_piece(pos, SQUARE_OF(7, i), (char)toupper(backRank[i]));
+    }
+    pos->sideToMove = SIDE_WHITE;
+    pos->castlingRights = CASTLE_ALL;
+    pos->enPassantSquare = -1;
+    pos->halfmoveClock = 0;
+    pos->fullmoveNumber = 1;
+    pos->undoCount = 0;
+    pos->key ^= zobristCastling[pos->castlingRights];
+}
+
+int isKingInCheck(const BoardState* boardState, int side); // With the attack tables below.
+
+/*
+ * load_fen:
+ * Sets up the position from a FEN string: placement, side to move, castling rights,
+ * en passant square and the two clocks (which may be left out). Castling rights whose
+ * king or rook has left its square are dropped. Returns 0 if the string is malformed
+ * or the position is impossible (not one king per side, pawns on the back ranks, the
+ * side not to move in check), leaving the position in an unspecified state.
+ */
+int load_fen(Position* pos, const char* fen) {
+    clear_board(pos);
+    int row = 0, col = 0;
+    const char* p = fen;
+    while (*p == ' ') p++;
+    for (; *p && *p != ' '; p++) {
+        if (*p == '/') {
+            if (col != BOARD_DIM || ++row >= BOARD_DIM) return 0;
+            col = 0;
+        }
+        else if (*p >= '1' && *p <= '8') {
+            col += *p - '0';
+            if (col > BOARD_DIM) return 0;
+        }
+        else if (strchr("PNBRQKpnbrqk", *p) && col < BOARD_DIM) {
+            put_piece(pos, SQUARE_OF(row, col), *p);
+            col++;
+        }
+        else {
+            return 0;
+        }
+    }
+    if (row != BOARD_DIM - 1 || col != BOARD_DIM) return 0;
+    if (popcount(pos->board.pieces[SIDE_WHITE][KING]) != 1 || popcount(pos->board.pieces[SIDE_BLACK][KING]) != 1)
+        return 0;
+    // Pawns can never stand on the first or last rank.
+    if ((pos->board.pieces[SIDE_WHITE][PAWN] | pos->board.pieces[SIDE_BLACK][PAWN]) & (ROW_BB(0) | ROW_BB(7)))
+        return 0;
+
+    char side[2] = "", castling[5] = "", enPassant[3] = "";
+    int halfmove = 0, fullmove = 1;
+    if (sscanf(p, " %1s %4s %2s %d %d", side, castling, enPassant, &halfmove, &fullmove) < 3)
+        return 0;
+    if (side[0] != 'w' && side[0] != 'b') return 0;
+    pos->sideToMove = (side[0] == 'w') ? SIDE_WHITE : SIDE_BLACK;
+    if (pos->sideToMove == SIDE_BLACK)
+        pos->key ^= zobristBlackToMove;
+
+    pos->castlingRights = 0;
+    for (const char* c = castling; *c && *c != '-'; c++) {
+        switch (*c) {
+        case 'K': pos->castlingRights |= CASTLE_WHITE_KING; break;
+        case 'Q': pos->castlingRights |= CASTLE_WHITE_QUEEN; break;
+        case 'k': pos->castlingRights |= CASTLE_BLACK_KING; break;
+        case 'q': pos->castlingRights |= CASTLE_BLACK_QUEEN; break;
+        default: return 0;
+        }
+    }
+    // A right is dropped when its king or rook is not on its home square.
+    static const struct {
+        int row, col;
+        char symbol;
+        int rights;
+    } homeSquares[] = {
+        { 7, 4, 'K', CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN }, { 7, 7, 'R', CASTLE_WHITE_KING },
+        { 7, 0, 'R', CASTLE_WHITE_QUEEN }, { 0, 4, 'k', CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN },
+        { 0, 7, 'r', CASTLE_BLACK_KING }, { 0, 0, 'r', CASTLE_BLACK_QUEEN },
+    };
+    for (int i = 0; i < 6; i++)
+        if (pos->board.squares[homeSquares[i].row][homeSquares[i].col] != homeSquares[i].symbol)
+            pos->castlingRights &= ~homeSquares[i].rights;
+    pos->key ^= zobristCastling[pos->castlingRights];
+
+    pos->enPassantSquare = -1;
+    if (enPassant[0] != '-') {
+        // The target is behind a pawn that has just moved two squares: on the sixth rank
+        // with White to move, on the third with Black to move.
+        if (enPassant[0] < 'a' || enPassant[0] > 'h' || enPassant[1] != (pos->sideToMove == SIDE_WHITE ? '6' : '3'))
+            return 0;
+        pos->enPassantSquare = SQUARE_OF('8' - enPassant[1], enPassant[0] - 'a');
+        pos->key ^= zobristEnPassant[COL_OF(pos->enPassantSquare)];
+    }
+    pos->halfmoveClock = halfmove;
+    pos->fullmoveNumber = fullmove;
+    pos->undoCount = 0;
+    // The side that has just moved cannot have left its king in check.
+    return !isKingInCheck(&pos->board, pos->sideToMove == SIDE_WHITE ? SIDE_BLACK : SIDE_WHITE);
+}
+
+/*
+ * display_board:
+ * Prints the board along with file (a-h) and rank (1-8) labels.
+ */
+void display_board(const Position* pos) {
+    printf("  a b c d e f g h\n");
+    for (int r = 0; r < BOARD_DIM; r++) {
+        printf("%d ", 8 - r);
+        for (int c = 0; c < BOARD_DIM; c++) {
+            printf("%c ", pos->board.squares[r][c]);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * Attack tables:
+ * Pawn, knight and king attacks are precomputed per square. Rook and bishop attacks are
+ * looked up through magic bitboards: the relevant blockers are masked out of the occupancy,
+ * multiplied by a per-square magic number and shifted down to index a shared table.
+ * Build with -DUSE_PEXT on BMI2 hardware to index with the PEXT instruction instead.
+ */
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+typedef struct {
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard* attacks;
+    int shift;
+} SliderMagic;
+
+Bitboard pawnAttacks[2][BOARD_SQUARES];
+Bitboard knightAttacks[BOARD_SQUARES];
+Bitboard kingAttacks[BOARD_SQUARES];
+
+// Castling rights that survive a move touching each square (king and rook home squares clear theirs).
+int castlingMask[BOARD_SQUARES];
+
+// Squares strictly between two aligned squares, and the whole line through them (0 if not aligned).
+Bitboard betweenSquares[BOARD_SQUARES][BOARD_SQUARES];
+Bitboard lineThrough[BOARD_SQUARES][BOARD_SQUARES];
+
+SliderMagic rookMagics[BOARD_SQUARES];
+SliderMagic bishopMagics[BOARD_SQUARES];
+Bitboard rookAttackTable[0x19000];
+Bitboard bishopAttackTable[0x1480];
+
+static const int rookDirections[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+static const int bishopDirections[4][2] = { {1,1}, {1,-1}, {-1,1}, {-1,-1} };
+
+static inline Bitboard slider_attacks(const SliderMagic* m, Bitboard occupied) {
+#ifdef USE_PEXT
+    return m->attacks[_pext_u64(occupied, m->mask)];
+#else
+    return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+#endif
+}
+
+static inline Bitboard rook_attacks(int square, Bitboard occupied) {
+    return slider_attacks(&rookMagics[square], occupied);
+}
+
+static inline Bitboard bishop_attacks(int square, Bitboard occupied) {
+    return slider_attacks(&bishopMagics[square], occupied);
+}
+
+static inline Bitboard queen_attacks(int square, Bitboard occupied) {
+    return rook_attacks(square, occupied) | bishop_attacks(square, occupied);
+}
+
+/*
+ * prng_next:
+ * xorshift64* generator. Deterministic so table setup is reproducible between runs.
+ */
+Bitboard prng_next(Bitboard* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/*
+ * init_zobrist:
+ * Fills the Zobrist key tables with fixed pseudo-random numbers.
+ */
+void init_zobrist() {
+    Bitboard seed = 0x2545F4914F6CDD1DULL;
+    for (int side = 0; side < 2; side++)
+        for (int type = 0; type < PIECE_TYPES; type++)
+            for (int sq = 0; sq < BOARD_SQUARES; sq++)
+                zobristPieces[side][type][sq] = prng_next(&seed);
+    // Each combination of rights gets its own key, so 0 (no rights) hashes to 0.
+    zobristCastling[0] = 0;
+    for (int i = 1; i < 16; i++)
+        zobristCastling[i] = prng_next(&seed);
+    for (int col = 0; col < BOARD_DIM; col++)
+        zobristEnPassant[col] = prng_next(&seed);
+    zobristBlackToMove = prng_next(&seed);
+}
+
+/*
+ * ray_attacks:
+ * Reference slider attacks computed by walking each direction until a blocker.
+ * Only used while building the magic tables.
+ */
+static Bitboard ray_attacks(int square, Bitboard occupied, const int directions[4][2]) {
+    Bitboard attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int newRow = ROW_OF(square) + directions[d][0];
+        int newCol = COL_OF(square) + directions[d][1];
+        while (isInsideBoard(newRow, newCol)) {
+            attacks |= SQUARE_BB(SQUARE_OF(newRow, newCol));
+            if (occupied & SQUARE_BB(SQUARE_OF(newRow, newCol)))
+                break;
+            newRow += directions[d][0];
+            newCol += directions[d][1];
+        }
+    }
+    return attacks;
+}
+
+/*
+ * relevant_blockers:
+ * The squares whose occupancy can change a slider's attacks (the rays minus their last square).
+ */
+static Bitboard relevant_blockers(int square, const int directions[4][2]) {
+    Bitboard mask = 0;
+    for (int d = 0; d < 4; d++) {
+        int newRow = ROW_OF(square) + directions[d][0];
+        int newCol = COL_OF(square) + directions[d][1];
+        while (isInsideBoard(newRow + directions[d][0], newCol + directions[d][1])) {
+            mask |= SQUARE_BB(SQUARE_OF(newRow, newCol));
+            newRow += directions[d][0];
+            newCol += directions[d][1];
+        }
+    }
+    return mask;
+}
+
+/*
+ * init_slider_magics:
+ * Finds a collision-free magic number for every square by trial and fills the attack table.
+ */
+static void init_slider_magics(SliderMagic magics[], Bitboard table[], const int directions[4][2]) {
+    // Per-row generator seeds, picked offline so the rook search converges quickly.
+    static const Bitboard magicSeeds[BOARD_DIM] = { 1776, 1387, 250, 2719, 1643, 2078, 974, 30 };
+    static Bitboard occupancies[4096], references[4096];
+    static int epoch[4096], attempt = 0; // epoch[i] == attempt marks slots filled by this attempt.
+    Bitboard seed = 0;
+    Bitboard* next = table;
+
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        SliderMagic* m = &magics[sq];
+        if (COL_OF(sq) == 0)
+            seed = magicSeeds[ROW_OF(sq)];
+        m->mask = relevant_blockers(sq, directions);
+        m->shift = 64 - popcount(m->mask);
+        m->attacks = next;
+
+        // Enumerate every subset of the mask (Carry-Rippler) with its reference attacks.
+        int size = 0;
+        Bitboard subset = 0;
+        do {
+            occupancies[size] = subset;
+            references[size] = ray_attacks(sq, subset, directions);
+#ifdef USE_PEXT
+            m->attacks[_pext_u64(subset, m->mask)] = references[size];
+#endif
+            size++;
+            subset = (subset - m->mask) & m->mask;
+        } while (subset);
+        next += size;
+
+#ifndef USE_PEXT
+        for (int found = 0; !found; ) {
+            do {
+                m->magic = prng_next(&seed) & prng_next(&seed) & prng_next(&seed);
+            } while (popcount((m->mask * m->magic) >> 56) < 6);
+            attempt++;
+            found = 1;
+            for (int i = 0; i < size; i++) {
+                unsigned index = (unsigned)(((occupancies[i] & m->mask) * m->magic) >> m->shift);
+                if (epoch[index] < attempt) {
+                    epoch[index] = attempt;
+                    m->attacks[index] = references[i];
+                }
+                else if (m->attacks[index] != references[i]) {
+                    found = 0;
+                    break;
+                }
+            }
+        }
+#endif
+    }
+}
+
+/*
+ * init_attack_tables:
+ * Builds the leaper and slider attack tables. Must run once before any move generation.
+ */
+void init_attack_tables() {
+    int knightOffsets[8][2] = { {-2,-1}, {-2,1}, {-1,-2}, {-1,2},
+                                {1,-2}, {1,2}, {2,-1}, {2,1} };
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        int row = ROW_OF(sq), col = COL_OF(sq);
+        pawnAttacks[SIDE_WHITE][sq] = pawnAttacks[SIDE_BLACK][sq] = 0;
+        knightAttacks[sq] = kingAttacks[sq] = 0;
+        for (int dc = -1; dc <= 1; dc += 2) {
+            // White pawns move towards row 0, Black pawns towards row 7.
+            if (isInsideBoard(row - 1, col + dc))
+                pawnAttacks[SIDE_WHITE][sq] |= SQUARE_BB(SQUARE_OF(row - 1, col + dc));
+            if (isInsideBoard(row + 1, col + dc))
+                pawnAttacks[SIDE_BLACK][sq] |= SQUARE_BB(SQUARE_OF(row + 1, col + dc));
+        }
+        for (int i = 0; i < 8; i++) {
+            if (isInsideBoard(row + knightOffsets[i][0], col + knightOffsets[i][1]))
+                knightAttacks[sq] |= SQUARE_BB(SQUARE_OF(row + knightOffsets[i][0], col + knightOffsets[i][1]));
+        }
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                if ((dr || dc) && isInsideBoard(row + dr, col + dc))
+                    kingAttacks[sq] |= SQUARE_BB(SQUARE_OF(row + dr, col + dc));
+            }
+        }
+    }
+    init_slider_magics(rookMagics, rookAttackTable, rookDirections);
+    init_slider_magics(bishopMagics, bishopAttackTable, bishopDirections);
+    init_zobrist();
+
+    for (int sq = 0; sq < BOARD_SQUARES; sq++)
+        castlingMask[sq] = CASTLE_ALL;
+    castlingMask[SQUARE_OF(7, 4)] &= ~(CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN);
+    castlingMask[SQUARE_OF(7, 7)] &= ~CASTLE_WHITE_KING;
+    castlingMask[SQUARE_OF(7, 0)] &= ~CASTLE_WHITE_QUEEN;
+    castlingMask[SQUARE_OF(0, 4)] &= ~(CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN);
+    castlingMask[SQUARE_OF(0, 7)] &= ~CASTLE_BLACK_KING;
+    castlingMask[SQUARE_OF(0, 0)] &= ~CASTLE_BLACK_QUEEN;
+
+    for (int a = 0; a < BOARD_SQUARES; a++) {
+        for (int b = 0; b < BOARD_SQUARES; b++) {
+            betweenSquares[a][b] = lineThrough[a][b] = 0;
+            if (a == b) continue;
+            if (rook_attacks(a, 0) & SQUARE_BB(b)) {
+                betweenSquares[a][b] = rook_attacks(a, SQUARE_BB(b)) & rook_attacks(b, SQUARE_BB(a));
+                lineThrough[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | SQUARE_BB(a) | SQUARE_BB(b);
+            }
+            else if (bishop_attacks(a, 0) & SQUARE_BB(b)) {
+                betweenSquares[a][b] = bishop_attacks(a, SQUARE_BB(b)) & bishop_attacks(b, SQUARE_BB(a));
+                lineThrough[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | SQUARE_BB(a) | SQUARE_BB(b);
+            }
+        }
+    }
+}
+
+/*
+ * move_pieces:
+ * Moves the pieces for a move by side Us (including the castling rook, the en passant
+ * victim and promotions) without touching castling rights or the en passant target.
+ */
+template<Color Us>
+static void move_pieces(Position* pos, ChessMove move) {
+    BoardState* boardState = &pos->board;
+    int src = SQUARE_OF(move.src_row, move.src_col);
+    int dst = SQUARE_OF(move.dst_row, move.dst_col);
+    char pieceSymbol = boardState->squares[move.src_row][move.src_col];
+    int type = pieceTypeOf(pieceSymbol);
+
+    // En passant: a diagonal pawn move onto an empty square removes the pawn behind it.
+    if (type == PAWN && move.src_col != move.dst_col &&
+        boardState->squares[move.dst_row][move.dst_col] == EMPTY_CELL)
+        remove_piece(pos, SQUARE_OF(move.src_row, move.dst_col));
+
+    remove_piece(pos, dst);
+    remove_piece(pos, src);
+    put_piece(pos, dst, move.promoteTo ? move.promoteTo : pieceSymbol);
+
+    // Castling: bring the rook over the king.
+    if (type == KING && abs(move.dst_col - move.src_col) == 2) {
+        int rookFrom = (move.dst_col > move.src_col) ? 7 : 0;
+        int rookTo = (move.dst_col > move.src_col) ? move.dst_col - 1 : move.dst_col + 1;
+        remove_piece(pos, SQUARE_OF(move.src_row, rookFrom));
+        put_piece(pos, SQUARE_OF(move.src_row, rookTo), pieceSymbols[Us][ROOK]);
+    }
+}
+
+/*
+ * execute_move_on_board:
+ * Applies a move to the position, updating castling rights, handling en passant,
+ * moving the rook when castling and passing the turn to the other side. The work is
+ * done by the instantiation for the side to move.
+ */
+template<Color Us>
+static void execute_move(Position* pos, ChessMove move) {
+    int src = SQUARE_OF(move.src_row, move.src_col);
+    int dst = SQUARE_OF(move.dst_row, move.dst_col);
+    int isPawn = pieceTypeOf(pos->board.squares[move.src_row][move.src_col]) == PAWN;
+
+    // Captures and pawn moves reset the fifty-move counter.
+    if (isPawn || pos->board.squares[move.dst_row][move.dst_col] != EMPTY_CELL)
+        pos->halfmoveClock = 0;
+    else
+        pos->halfmoveClock++;
+
+    // Clear en passant target (it lasts only one move).
+    if (pos->enPassantSquare != -1)
+        pos->key ^= zobristEnPassant[COL_OF(pos->enPassantSquare)];
+    pos->enPassantSquare = -1;
+    move_pieces<Us>(pos, move);
+
+    // Moving from or onto a king or rook home square loses the matching rights.
+    pos->key ^= zobristCastling[pos->castlingRights];
+    pos->castlingRights &= castlingMask[src] & castlingMask[dst];
+    pos->key ^= zobristCastling[pos->castlingRights];
+    // Set en passant target if a pawn moves two squares forward.
+    if (isPawn && abs(move.dst_row - move.src_row) == 2) {
+        pos->enPassantSquare = SQUARE_OF((move.src_row + move.dst_row) / 2, move.src_col);
+        pos->key ^= zobristEnPassant[move.src_col];
+    }
+
+    if (Us == SIDE_BLACK)
+        pos->fullmoveNumber++;
+    pos->sideToMove = Us ^ 1;
+    pos->key ^= zobristBlackToMove;
+}
+
+void execute_move_on_board(Position* pos, ChessMove move) {
+    if (pos->sideToMove == SIDE_WHITE)
+        execute_move<SIDE_WHITE>(pos, move);
+    else
+        execute_move<SIDE_BLACK>(pos, move);
+}
+
+/*
+ * make_move / unmake_move:
+ * Play a move, recording on the position's undo stack only what it changes, and take
+ * the most recent one back. Used by the search in place of copying the state.
+ */
+void make_move(Position* pos, ChessMove move) {
+    UndoInfo* undo = &pos->undoStack[pos->undoCount++];
+    undo->move = move;
+    undo->castlingRights = pos->castlingRights;
+    undo->enPassantSquare = pos->enPassantSquare;
+    undo->halfmoveClock = pos->halfmoveClock;
+    undo->key = pos->key;
+    undo->captured = pos->board.squares[move.dst_row][move.dst_col];
+    if (undo->captured == EMPTY_CELL && SQUARE_OF(move.dst_row, move.dst_col) == pos->enPassantSquare &&
+        pieceTypeOf(pos->board.squares[move.src_row][move.src_col]) == PAWN)
+        undo->captured = pos->board.squares[move.src_row][move.dst_col];
+    execute_move_on_board(pos, move);
+}
+
+void unmake_move(Position* pos) {
+    UndoInfo* undo = &pos->undoStack[--pos->undoCount];
+    BoardState* board = &pos->board;
+    ChessMove move = undo->move;
+    int src = SQUARE_OF(move.src_row, move.src_col);
+    int dst = SQUARE_OF(move.dst_row, move.dst_col);
+    char pieceSymbol = board->squares[move.dst_row][move.dst_col];
+
+    remove_piece(pos, dst);
+    if (move.promoteTo)
+        pieceSymbol = pieceSymbols[pieceSideOf(pieceSymbol)][PAWN];
+    put_piece(pos, src, pieceSymbol);
+
+    if (undo->captured != EMPTY_CELL) {
+        // An en passant victim sits beside the source square, not on the destination.
+        if (dst == undo->enPassantSquare && pieceTypeOf(pieceSymbol) == PAWN)
+            put_piece(pos, SQUARE_OF(move.src_row, move.dst_col), undo->captured);
+        else
+            put_piece(pos, dst, undo->captured);
+    }
+    // Castling: return the rook to its corner.
+    if (pieceTypeOf(pieceSymbol) == KING && abs(move.dst_col - move.src_col) == 2) {
+        int rookFrom = (move.dst_col > move.src_col) ? 7 : 0;
+        int rookTo = (move.dst_col > move.src_col) ? move.dst_col - 1 : move.dst_col + 1;
+        char rookSymbol = board->squares[move.src_row][rookTo];
+        remove_piece(pos, SQUARE_OF(move.src_row, rookTo));
+        put_piece(pos, SQUARE_OF(move.src_row, rookFrom), rookSymbol);
+    }
+    pos->castlingRights = undo->castlingRights;
+    pos->enPassantSquare = undo->enPassantSquare;
+    pos->halfmoveClock = undo->halfmoveClock;
+    pos->key = undo->key;
+    pos->sideToMove = (pos->sideToMove == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+    if (pos->sideToMove == SIDE_BLACK)
+        pos->fullmoveNumber--;
+}
+
+/*
+ * make_null_move / unmake_null_move:
+ * Pass the turn without moving, for null-move pruning. The undo record holds an empty
+ * move (a8 to a8), which is how the search tells a null move apart from a real one.
+ */
+void make_null_move(Position* pos) {
+    UndoInfo* undo = &pos->undoStack[pos->undoCount++];
+    memset(&undo->move, 0, sizeof(undo->move));
+    undo->captured = EMPTY_CELL;
+    undo->castlingRights = pos->castlingRights;
+    undo->enPassantSquare = pos->enPassantSquare;
+    undo->halfmoveClock = pos->halfmoveClock;
+    undo->key = pos->key;
+    if (pos->enPassantSquare != -1)
+        pos->key ^= zobristEnPassant[COL_OF(pos->enPassantSquare)];
+    pos->enPassantSquare = -1;
+    pos->halfmoveClock++;
+    pos->sideToMove = (pos->sideToMove == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+    pos->key ^= zobristBlackToMove;
+}
+
+void unmake_null_move(Position* pos) {
+    UndoInfo* undo = &pos->undoStack[--pos->undoCount];
+    pos->enPassantSquare = undo->enPassantSquare;
+    pos->halfmoveClock = undo->halfmoveClock;
+    pos->key = undo->key;
+    pos->sideToMove = (pos->sideToMove == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+}
+
+/*
+ * attackers_to:
+ * Returns every piece of either color that attacks the square, given an occupancy.
+ */
+Bitboard attackers_to(const BoardState* boardState, int square, Bitboard occupied) {
+    const Bitboard (*p)[PIECE_TYPES] = boardState->pieces;
+    return (pawnAttacks[SIDE_BLACK][square] & p[SIDE_WHITE][PAWN])
+        | (pawnAttacks[SIDE_WHITE][square] & p[SIDE_BLACK][PAWN])
+        | (knightAttacks[square] & (p[SIDE_WHITE][KNIGHT] | p[SIDE_BLACK][KNIGHT]))
+        | (kingAttacks[square] & (p[SIDE_WHITE][KING] | p[SIDE_BLACK][KING]))
+        | (rook_attacks(square, occupied) & (p[SIDE_WHITE][ROOK] | p[SIDE_BLACK][ROOK] |
+                                             p[SIDE_WHITE][QUEEN] | p[SIDE_BLACK][QUEEN]))
+        | (bishop_attacks(square, occupied) & (p[SIDE_WHITE][BISHOP] | p[SIDE_BLACK][BISHOP] |
+                                               p[SIDE_WHITE][QUEEN] | p[SIDE_BLACK][QUEEN]));
+}
+
+/*
+ * isCellAttacked:
+ * Checks whether the square at (row, col) is attacked by any enemy piece.
+ * It considers pawn, knight, sliding (rook, bishop, queen), and king moves.
+ * square_attacked<Attacker> is the same test for a side known at compile time.
+ */
+template<Color Attacker>
+static inline int square_attacked(const BoardState* boardState, int square) {
+    const Bitboard* enemy = boardState->pieces[Attacker];
+    return (pawnAttacks[Attacker ^ 1][square] & enemy[PAWN]) ||
+        (knightAttacks[square] & enemy[KNIGHT]) ||
+        (kingAttacks[square] & enemy[KING]) ||
+        (bishop_attacks(square, boardState->occupied) & (enemy[BISHOP] | enemy[QUEEN])) ||
+        (rook_attacks(square, boardState->occupied) & (enemy[ROOK] | enemy[QUEEN]));
+}
+
+int isCellAttacked(const BoardState* boardState, int row, int col, int attackerSide) {
+    return (attackerSide == SIDE_WHITE) ? square_attacked<SIDE_WHITE>(boardState, SQUARE_OF(row, col))
+                                        : square_attacked<SIDE_BLACK>(boardState, SQUARE_OF(row, col));
+}
+
+/*
+ * isKingInCheck:
+ * Determines if the king for the given side is in check.
+ */
+template<Color Us>
+static inline int king_in_check(const BoardState* boardState) {
+    Bitboard king = boardState->pieces[Us][KING];
+    if (!king) return 1; // Missing king => consider it in check.
+    return square_attacked<Us ^ 1>(boardState, lsb_index(king));
+}
+
+int isKingInCheck(const BoardState* boardState, int side) {
+    return (side == SIDE_WHITE) ? king_in_check<SIDE_WHITE>(boardState) : king_in_check<SIDE_BLACK>(boardState);
+}
+
+/*
+ * add_move:
+ * Appends a move to the list.
+ */
+static inline void add_move(int src, int dst, char promoteTo, ChessMove movesList[], int* moveCount) {
+    ChessMove* mv = &movesList[(*moveCount)++];
+    mv->src_row = ROW_OF(src); mv->src_col = COL_OF(src);
+    mv->dst_row = ROW_OF(dst); mv->dst_col = COL_OF(dst);
+    mv->promoteTo = promoteTo;
+}
+
+/*
+ * add_pawn_moves:
+ * Adds a pawn move, expanding it into the four promotion choices on the last rank.
+ */
+template<Color Us>
+static inline void add_pawn_moves(int src, int dst, ChessMove movesList[], int* moveCount) {
+    constexpr int promotionRow = (Us == SIDE_WHITE) ? 0 : 7;
+    if (ROW_OF(dst) == promotionRow) {
+        for (int type = QUEEN; type >= KNIGHT; type--)
+            add_move(src, dst, pieceSymbols[Us][type], movesList, moveCount);
+    }
+    else {
+        add_move(src, dst, 0, movesList, moveCount);
+    }
+}
+
+/*
+ * pinned_pieces:
+ * Returns the pieces of `side` that are the only blocker between their king and an enemy slider.
+ */
+Bitboard pinned_pieces(const BoardState* boardState, int side, int kingSquare) {
+    int opponent = (side == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+    const Bitboard* enemy = boardState->pieces[opponent];
+    Bitboard pinned = 0;
+    Bitboard snipers = (rook_attacks(kingSquare, 0) & (enemy[ROOK] | enemy[QUEEN])) |
+        (bishop_attacks(kingSquare, 0) & (enemy[BISHOP] | enemy[QUEEN]));
+    while (snipers) {
+        Bitboard blockers = betweenSquares[kingSquare][pop_lsb(&snipers)] & boardState->occupied;
+        if (blockers && !(blockers & (blockers - 1)))
+            pinned |= blockers & boardState->occupancy[side];
+    }
+    return pinned;
+}
+
+/*
+ * en_passant_is_safe:
+ * En passant removes two pieces from one rank, which pin masks do not model, so it is
+ * checked directly: the king must not be attacked once both pawns have left their squares.
+ */
+template<Color Us>
+static int en_passant_is_safe(const BoardState* board, int kingSquare, int src, int dst) {
+    constexpr int opponent = Us ^ 1;
+    int capturedSquare = SQUARE_OF(ROW_OF(src), COL_OF(dst));
+    Bitboard occupied = (board->occupied ^ SQUARE_BB(src) ^ SQUARE_BB(capturedSquare)) | SQUARE_BB(dst);
+    return !(attackers_to(board, kingSquare, occupied) & board->occupancy[opponent] &
+             ~SQUARE_BB(capturedSquare));
+}
+
+/*
+ * generate_moves:
+ * Generates legal moves for the side to move: every move, or with capturesOnly set just
+ * captures (including en passant) and promotions, without producing any quiet moves.
+ *
+ * Legality is decided up front: checkers and pinned pieces are computed once, other
+ * pieces are restricted to the check-evasion mask and their pin ray, and only king
+ * moves and en passant get a dedicated safety test. The side to move picks the
+ * instantiation once, so pawn directions and castling squares are constants inside.
+ */
+// Which moves generate_moves produces. Captures include every promotion; quiets are the rest.
+#define GEN_ALL 0
+#define GEN_CAPTURES 1
+#define GEN_QUIETS 2
+
+template<Color Us>
+static int generate_moves(const Position* pos, ChessMove movesList[], int genType) {
+    constexpr int side = Us;
+    constexpr int opponent = Us ^ 1;
+    int moveCount = 0;
+    const BoardState* board = &pos->board;
+    const Bitboard* own = board->pieces[side];
+    Bitboard enemies = board->occupancy[opponent];
+    Bitboard empty = ~board->occupied;
+    if (!own[KING]) return 0;
+    int kingSquare = lsb_index(own[KING]);
+
+    Bitboard checkers = attackers_to(board, kingSquare, board->occupied) & enemies;
+    Bitboard pinned = pinned_pieces(board, side, kingSquare);
+
+    // King moves: the destination must be safe once the king has left its square,
+    // so sliders see through it.
+    Bitboard occupiedWithoutKing = board->occupied ^ own[KING];
+    Bitboard destinations = (genType == GEN_CAPTURES) ? enemies : (genType == GEN_QUIETS) ? empty : ~board->occupancy[side];
+    Bitboard kingMoves = kingAttacks[kingSquare] & destinations;
+    while (kingMoves) {
+        int dst = pop_lsb(&kingMoves);
+        if (!(attackers_to(board, dst, occupiedWithoutKing) & enemies))
+            add_move(kingSquare, dst, 0, movesList, &moveCount);
+    }
+    // In double check only the king can move.
+    if (checkers & (checkers - 1))
+        return moveCount;
+
+    // Other pieces must capture the checker or block its ray.
+    Bitboard checkMask = checkers ? (betweenSquares[kingSquare][lsb_index(checkers)] | checkers) : ~0ULL;
+    Bitboard targets = destinations & checkMask;
+
+    // Pawn pushes, shifted as a set. White moves towards row 0, Black towards row 7.
+    constexpr int forward = (side == SIDE_WHITE) ? -8 : 8;
+    constexpr Bitboard promotionRow = ROW_BB(side == SIDE_WHITE ? 0 : 7);
+    constexpr Bitboard doublePushRow = ROW_BB(side == SIDE_WHITE ? 5 : 2);
+    Bitboard singlePushes = ((side == SIDE_WHITE) ? own[PAWN] >> 8 : own[PAWN] << 8) & empty;
+    Bitboard doublePushes = ((side == SIDE_WHITE) ? (singlePushes & doublePushRow) >> 8
+                                                  : (singlePushes & doublePushRow) << 8) & empty;
+    singlePushes &= checkMask;
+    doublePushes &= checkMask;
+    if (genType == GEN_CAPTURES) {
+        // Only pushes that promote.
+        singlePushes &= promotionRow;
+        doublePushes = 0;
+    }
+    else if (genType == GEN_QUIETS) {
+        singlePushes &= ~promotionRow;
+    }
+    while (singlePushes) {
+        int dst = pop_lsb(&singlePushes);
+        int src = dst - forward;
+        if (!(pinned & SQUARE_BB(src)) || (lineThrough[kingSquare][src] & SQUARE_BB(dst)))
+            add_pawn_moves<Us>(src, dst, movesList, &moveCount);
+    }
+    while (doublePushes) {
+        int dst = pop_lsb(&doublePushes);
+        int src = dst - 2 * forward;
+        if (!(pinned & SQUARE_BB(src)) || (lineThrough[kingSquare][src] & SQUARE_BB(dst)))
+            add_move(src, dst, 0, movesList, &moveCount);
+    }
+
+    // Pawn captures, including en passant.
+    Bitboard pawns = (genType == GEN_QUIETS) ? 0 : own[PAWN];
+    while (pawns) {
+        int src = pop_lsb(&pawns);
+        Bitboard captures = pawnAttacks[side][src] & enemies & checkMask;
+        if (pinned & SQUARE_BB(src))
+            captures &= lineThrough[kingSquare][src];
+        while (captures)
+            add_pawn_moves<Us>(src, pop_lsb(&captures), movesList, &moveCount);
+        if (pos->enPassantSquare != -1 && (pawnAttacks[side][src] & SQUARE_BB(pos->enPassantSquare)) &&
+            en_passant_is_safe<Us>(board, kingSquare, src, pos->enPassantSquare))
+            add_move(src, pos->enPassantSquare, 0, movesList, &moveCount);
+    }
+
+    // Knights and sliders: attack set minus own pieces. A pinned knight can never move.
+    for (int type = KNIGHT; type <= QUEEN; type++) {
+        Bitboard pieces = own[type];
+        while (pieces) {
+            int src = pop_lsb(&pieces);
+            Bitboard moves;
+            switch (type) {
+            case KNIGHT: moves = knightAttacks[src]; break;
+            case BISHOP: moves = bishop_attacks(src, board->occupied); break;
+            case ROOK: moves = rook_attacks(src, board->occupied); break;
+            default: moves = queen_attacks(src, board->occupied); break;
+            }
+            moves &= targets;
+            if (pinned & SQUARE_BB(src))
+                moves &= lineThrough[kingSquare][src];
+            while (moves)
+                add_move(src, pop_lsb(&moves), 0, movesList, &moveCount);
+        }
+    }
+
+    if (genType == GEN_CAPTURES)
+        return moveCount;
+
+    // --- Castling Moves ---
+    constexpr int homeRow = (side == SIDE_WHITE) ? 7 : 0;
+    constexpr int kingSide = (side == SIDE_WHITE) ? CASTLE_WHITE_KING : CASTLE_BLACK_KING;
+    constexpr int queenSide = (side == SIDE_WHITE) ? CASTLE_WHITE_QUEEN : CASTLE_BLACK_QUEEN;
+    constexpr char rookSymbol = pieceSymbols[side][ROOK];
+    if ((pos->castlingRights & (kingSide | queenSide)) && !checkers && kingSquare == SQUARE_OF(homeRow, 4)) {
+        // Kingside castling.
+        if ((pos->castlingRights & kingSide) && board->squares[homeRow][7] == rookSymbol &&
+            board->squares[homeRow][5] == EMPTY_CELL && board->squares[homeRow][6] == EMPTY_CELL &&
+            !square_attacked<opponent>(board, SQUARE_OF(homeRow, 5)) &&
+            !square_attacked<opponent>(board, SQUARE_OF(homeRow, 6)))
+            add_move(kingSquare, SQUARE_OF(homeRow, 6), 0, movesList, &moveCount);
+        // Queenside castling.
+        if ((pos->castlingRights & queenSide) && board->squares[homeRow][0] == rookSymbol &&
+            board->squares[homeRow][1] == EMPTY_CELL && board->squares[homeRow][2] == EMPTY_CELL &&
+            board->squares[homeRow][3] == EMPTY_CELL &&
+            !square_attacked<opponent>(board, SQUARE_OF(homeRow, 3)) &&
+            !square_attacked<opponent>(board, SQUARE_OF(homeRow, 2)))
+            add_move(kingSquare, SQUARE_OF(homeRow, 2), 0, movesList, &moveCount);
+    }
+    return moveCount;
+}
+
+static int generate_moves(const Position* pos, ChessMove movesList[], int genType) {
+    return (pos->sideToMove == SIDE_WHITE) ? generate_moves<SIDE_WHITE>(pos, movesList, genType)
+                                           : generate_moves<SIDE_BLACK>(pos, movesList, genType);
+}
+
+/*
+ * generateLegalMoves:
+ * Generates all legal moves for the side to move. It includes normal moves, pawn moves
+ * (with double moves, en passant, and promotions), as well as castling moves.
+ */
+int generateLegalMoves(const Position* pos, ChessMove movesList[]) {
+    return generate_moves(pos, movesList, GEN_ALL);
+}
+
+/*
+ * generateCaptureMoves:
+ * Generates only the legal captures and promotions, for the quiescence search.
+ */
+int generateCaptureMoves(const Position* pos, ChessMove movesList[]) {
+    return generate_moves(pos, movesList, GEN_CAPTURES);
+}
+
+/*
+ * generateQuietMoves:
+ * Generates the legal moves that neither capture nor promote, castling included.
+ */
+int generateQuietMoves(const Position* pos, ChessMove movesList[]) {
+    return generate_moves(pos, movesList, GEN_QUIETS);
+}
+
+/*
+ * move_is_legal:
+ * Checks a single move, such as a hash move or a killer from another position, without
+ * generating the move list: the piece must be able to make it, and the king must not be
+ * attacked afterwards. Castling is rare enough to be checked against the generator.
+ */
+int move_is_legal(const Position* pos, ChessMove move) {
+    const BoardState* board = &pos->board;
+    int side = pos->sideToMove;
+    int opponent = (side == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+    if (!isInsideBoard(move.src_row, move.src_col) || !isInsideBoard(move.dst_row, move.dst_col))
+        return 0;
+    int src = SQUARE_OF(move.src_row, move.src_col);
+    int dst = SQUARE_OF(move.dst_row, move.dst_col);
+    if (!(board->occupancy[side] & SQUARE_BB(src)) || (board->occupancy[side] & SQUARE_BB(dst)))
+        return 0;
+    int type = pieceTypeOf(board->squares[move.src_row][move.src_col]);
+    int kingSquare = lsb_index(board->pieces[side][KING]);
+
+    if (type == PAWN) {
+        int forward = (side == SIDE_WHITE) ? -8 : 8;
+        int promotionRow = (side == SIDE_WHITE) ? 0 : 7;
+        if (move.promoteTo ? (ROW_OF(dst) != promotionRow || pieceSideOf(move.promoteTo) != side ||
+                              pieceTypeOf(move.promoteTo) == PAWN || pieceTypeOf(move.promoteTo) == KING)
+                           : ROW_OF(dst) == promotionRow)
+            return 0;
+        if (dst == src + forward) {
+            if (board->occupied & SQUARE_BB(dst)) return 0;
+        }
+        else if (dst == src + 2 * forward && ROW_OF(src) == (side == SIDE_WHITE ? 6 : 1)) {
+            if (board->occupied & (SQUARE_BB(dst) | SQUARE_BB(src + forward))) return 0;
+        }
+        else if (pawnAttacks[side][src] & SQUARE_BB(dst)) {
+            if (dst == pos->enPassantSquare)
+                return (side == SIDE_WHITE) ? en_passant_is_safe<SIDE_WHITE>(board, kingSquare, src, dst)
+                                            : en_passant_is_safe<SIDE_BLACK>(board, kingSquare, src, dst);
+            if (!(board->occupancy[opponent] & SQUARE_BB(dst))) return 0;
+        }
+        else {
+            return 0;
+        }
+    }
+    else {
+        if (move.promoteTo) return 0;
+        Bitboard attacks;
+        switch (type) {
+        case KNIGHT: attacks = knightAttacks[src]; break;
+        case BISHOP: attacks = bishop_attacks(src, board->occupied); break;
+        case ROOK: attacks = rook_attacks(src, board->occupied); break;
+        case QUEEN: attacks = queen_attacks(src, board->occupied); break;
+        default:
+            if (kingAttacks[src] & SQUARE_BB(dst))
+                return !(attackers_to(board, dst, board->occupied ^ SQUARE_BB(src)) & board->occupancy[opponent]);
+            ChessMove quiets[MAX_LEGAL_MOVES];
+            int numQuiets = generateQuietMoves(pos, quiets);
+            for (int i = 0; i < numQuiets; i++)
+                if (quiets[i].src_row == move.src_row && quiets[i].src_col == move.src_col &&
+                    quiets[i].dst_row == move.dst_row && quiets[i].dst_col == move.dst_col)
+                    return 1;
+            return 0;
+        }
+        if (!(attacks & SQUARE_BB(dst))) return 0;
+    }
+
+    // A piece captured on dst no longer attacks the king.
+    Bitboard occupied = (board->occupied ^ SQUARE_BB(src)) | SQUARE_BB(dst);
+    return !(attackers_to(board, kingSquare, occupied) & board->occupancy[opponent] & ~SQUARE_BB(dst));
+}
+
+/*
+ * output_move:
+ * Converts a ChessMove to standard coordinate notation (e.g., "e2e4") and prints it.
+ * Promotions append "=Q" (or "=q").
+ */
+void output_move(ChessMove move) {
+    char srcFile = 'a' + move.src_col;
+    char srcRank = '8' - move.src_row;
+    char dstFile = 'a' + move.dst_col;
+    char dstRank = '8' - move.dst_row;
+    printf("%c%c%c%c", srcFile, srcRank, dstFile, dstRank);
+    if (move.promoteTo)
+        printf("=%c", move.promoteTo);
+}
+
+/*
+ * interpret_move:
+ * Parses a move string (e.g., "e2e4", "e7e8=Q" or "e7e8q") into a ChessMove structure.
+ * It also performs basic validation against the side to move.
+ */
+int interpret_move(const Position* pos, char* input, ChessMove* move) {
+    if (strlen(input) < 4) return 0;
+    move->src_col = input[0] - 'a';
+    move->src_row = '8' - input[1];
+    move->dst_col = input[2] - 'a';
+    move->dst_row = '8' - input[3];
+    move->promoteTo = 0;
+    if (strlen(input) >= 6 && input[4] == '=')
+        move->promoteTo = input[5];
+    else if (strlen(input) >= 5 && isalpha((unsigned char)input[4]))
+        move->promoteTo = input[4];
+    if (!isInsideBoard(move->src_row, move->src_col) || !isInsideBoard(move->dst_row, move->dst_col))
+        return 0;
+    char piece = pos->board.squares[move->src_row][move->src_col];
+    if (piece == EMPTY_CELL) return 0;
+    if (pos->sideToMove == SIDE_WHITE && !isPieceWhite(piece)) return 0;
+    if (pos->sideToMove == SIDE_BLACK && !isPieceBlack(piece)) return 0;
+    // The promotion letter may be given in either case; moves use the mover's case.
+    if (move->promoteTo)
+        move->promoteTo = isPieceWhite(piece) ? (char)toupper(move->promoteTo) : (char)tolower(move->promoteTo);
+    return 1;
+}
+
+/*
+ * Piece-square tables, from White's point of view with rank 8 in the first row (the same
+ * layout as the board array). Black uses the vertically mirrored square.
+ */
+static const int pawnTable[BOARD_SQUARES] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     10,  10,  20,  30,  30,  20,  10,  10,
+      5,   5,  10,  25,  25,  10,   5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0 };
+static const int pawnEndgameTable[BOARD_SQUARES] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     80,  80,  80,  80,  80,  80,  80,  80,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     30,  30,  30,  30,  30,  30,  30,  30,
+     15,  15,  15,  15,  15,  15,  15,  15,
+      5,   5,   5,   5,   5,   5,   5,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0 };
+static const int knightTable[BOARD_SQUARES] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50 };
+static const int bishopTable[BOARD_SQUARES] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20 };
+static const int rookTable[BOARD_SQUARES] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10,  10,  10,  10,  10,   5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      0,   0,   0,   5,   5,   0,   0,   0 };
+static const int queenTable[BOARD_SQUARES] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20 };
+static const int kingTable[BOARD_SQUARES] = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20 };
+static const int kingEndgameTable[BOARD_SQUARES] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50 };
+
+// Pawn structure masks, filled by init_eval_tables: the squares ahead of a pawn on its
+// own and the neighbouring files (no enemy pawn there makes it passed), and the squares
+// beside and behind it on the neighbouring files (where its supporters would stand).
+Bitboard fileBB[BOARD_DIM];
+Bitboard adjacentFiles[BOARD_DIM];
+Bitboard passedPawnMask[2][BOARD_SQUARES];
+Bitboard pawnSupportMask[2][BOARD_SQUARES];
+
+// Material in the middlegame and endgame. Kings are never traded, so they count zero.
+static const int materialMg[PIECE_TYPES] = { 100, 320, 330, 500, 900, 0 };
+static const int materialEg[PIECE_TYPES] = { 120, 320, 330, 500, 900, 0 };
+
+/*
+ * init_eval_tables:
+ * Combines material and piece-square values into the per-side tables that put_piece and
+ * remove_piece add and subtract. Must run before any position is set up.
+ */
+void init_eval_tables() {
+    const int* mgTables[PIECE_TYPES] = { pawnTable, knightTable, bishopTable, rookTable, queenTable, kingTable };
+    const int* egTables[PIECE_TYPES] = { pawnEndgameTable, knightTable, bishopTable, rookTable, queenTable, kingEndgameTable };
+    for (int type = 0; type < PIECE_TYPES; type++) {
+        for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+            pieceSquareMg[SIDE_WHITE][type][sq] = materialMg[type] + mgTables[type][sq];
+            pieceSquareEg[SIDE_WHITE][type][sq] = materialEg[type] + egTables[type][sq];
+            pieceSquareMg[SIDE_BLACK][type][sq] = -(materialMg[type] + mgTables[type][sq ^ 56]);
+            pieceSquareEg[SIDE_BLACK][type][sq] = -(materialEg[type] + egTables[type][sq ^ 56]);
+        }
+    }
+    for (int col = 0; col < BOARD_DIM; col++) {
+        fileBB[col] = 0;
+        for (int row = 0; row < BOARD_DIM; row++)
+            fileBB[col] |= SQUARE_BB(SQUARE_OF(row, col));
+    }
+    for (int col = 0; col < BOARD_DIM; col++)
+        adjacentFiles[col] = (col > 0 ? fileBB[col - 1] : 0) | (col < BOARD_DIM - 1 ? fileBB[col + 1] : 0);
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        // White moves towards row 0, Black towards row 7.
+        Bitboard above = 0, below = 0;
+        for (int row = 0; row < BOARD_DIM; row++) {
+            if (row < ROW_OF(sq)) above |= ROW_BB(row);
+            if (row > ROW_OF(sq)) below |= ROW_BB(row);
+        }
+        Bitboard files = fileBB[COL_OF(sq)] | adjacentFiles[COL_OF(sq)];
+        passedPawnMask[SIDE_WHITE][sq] = files & above;
+        passedPawnMask[SIDE_BLACK][sq] = files & below;
+        pawnSupportMask[SIDE_WHITE][sq] = adjacentFiles[COL_OF(sq)] & ~above;
+        pawnSupportMask[SIDE_BLACK][sq] = adjacentFiles[COL_OF(sq)] & ~below;
+    }
+}
+
+// Endgame knowledge. A won ending that is not yet a mate in view scores KNOWN_WIN plus a
+// term that steers towards the win, which keeps it below every mate score.
+#define KNOWN_WIN 10000
+
+// KPK bitbase: one bit per position with the pawn on files a-d (others are mirrored),
+// seen with the pawn's side as White, set when that side wins. 2 sides to move x 6 pawn
+// rows x 4 files x 64 x 64 king squares.
+#define KPK_INDEX_COUNT (2 * 6 * 4 * 64 * 64)
+unsigned int kpkBitbase[KPK_INDEX_COUNT / 32];
+
+#define KPK_INVALID 0
+#define KPK_UNKNOWN 1
+#define KPK_DRAW 2
+#define KPK_WIN 4
+
+static inline int kpk_index(int side, int whiteKing, int blackKing, int pawn) {
+    return whiteKing | (blackKing << 6) | (side << 12) | (COL_OF(pawn) << 13) | ((ROW_OF(pawn) - 1) << 15);
+}
+
+static inline int square_distance(int a, int b) {
+    int rows = abs(ROW_OF(a) - ROW_OF(b)), cols = abs(COL_OF(a) - COL_OF(b));
+    return rows > cols ? rows : cols;
+}
+
+/*
+ * kpk_initial / kpk_classify:
+ * The retrograde pass. kpk_initial settles the positions that are decided without
+ * looking ahead: illegal ones, a pawn that promotes safely, stalemate and a pawn that
+ * can be taken. kpk_classify decides a position from its successors: White wins if some
+ * move wins, Black draws if some move draws, and otherwise it is still unknown.
+ */
+static int kpk_initial(int side, int whiteKing, int blackKing, int pawn) {
+    int push = pawn - 8;
+    if (square_distance(whiteKing, blackKing) <= 1 || whiteKing == pawn || blackKing == pawn ||
+        (side == SIDE_WHITE && (pawnAttacks[SIDE_WHITE][pawn] & SQUARE_BB(blackKing))))
+        return KPK_INVALID;
+    if (side == SIDE_WHITE && ROW_OF(pawn) == 1 && whiteKing != push && blackKing != push &&
+        (square_distance(blackKing, push) > 1 || square_distance(whiteKing, push) == 1))
+        return KPK_WIN;
+    if (side == SIDE_BLACK &&
+        (!(kingAttacks[blackKing] & ~(kingAttacks[whiteKing] | pawnAttacks[SIDE_WHITE][pawn])) ||
+         (kingAttacks[blackKing] & ~kingAttacks[whiteKing] & SQUARE_BB(pawn))))
+        return KPK_DRAW;
+    return KPK_UNKNOWN;
+}
+
+static int kpk_classify(const unsigned char* results, int side, int whiteKing, int blackKing, int pawn) {
+    int good = (side == SIDE_WHITE) ? KPK_WIN : KPK_DRAW;
+    int bad = (side == SIDE_WHITE) ? KPK_DRAW : KPK_WIN;
+    int reached = KPK_INVALID;
+    Bitboard kingMoves = kingAttacks[side == SIDE_WHITE ? whiteKing : blackKing];
+    while (kingMoves) {
+        int to = pop_lsb(&kingMoves);
+        reached |= (side == SIDE_WHITE) ? results[kpk_index(SIDE_BLACK, to, blackKing, pawn)]
+                                        : results[kpk_index(SIDE_WHITE, whiteKing, to, pawn)];
+    }
+    if (side == SIDE_WHITE) {
+        // Pawn pushes; a push onto a king lands on an invalid entry and adds nothing.
+        if (ROW_OF(pawn) > 1)
+            reached |= results[kpk_index(SIDE_BLACK, whiteKing, blackKing, pawn - 8)];
+        if (ROW_OF(pawn) == 6 && pawn - 8 != whiteKing && pawn - 8 != blackKing)
+            reached |= results[kpk_index(SIDE_BLACK, whiteKing, blackKing, pawn - 16)];
+    }
+    return (reached & good) ? good : (reached & KPK_UNKNOWN) ? KPK_UNKNOWN : bad;
+}
+
+/*
+ * init_kpk_bitbase:
+ * Builds the KPK bitbase at startup by repeating the retrograde pass until nothing
+ * changes, then keeps only the win bits.
+ */
+void init_kpk_bitbase() {
+    unsigned char* results = (unsigned char*)malloc(KPK_INDEX_COUNT);
+    for (int index = 0; index < KPK_INDEX_COUNT; index++)
+        results[index] = (unsigned char)kpk_initial((index >> 12) & 1, index & 63, (index >> 6) & 63,
+            SQUARE_OF((index >> 15) + 1, (index >> 13) & 3));
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int index = 0; index < KPK_INDEX_COUNT; index++) {
+            if (results[index] != KPK_UNKNOWN)
+                continue;
+            int result = kpk_classify(results, (index >> 12) & 1, index & 63, (index >> 6) & 63,
+                SQUARE_OF((index >> 15) + 1, (index >> 13) & 3));
+            if (result != KPK_UNKNOWN) {
+                results[index] = (unsigned char)result;
+                changed = 1;
+            }
+        }
+    }
+    memset(kpkBitbase, 0, sizeof(kpkBitbase));
+    for (int index = 0; index < KPK_INDEX_COUNT; index++)
+        if (results[index] == KPK_WIN)
+            kpkBitbase[index >> 5] |= 1u << (index & 31);
+    free(results);
+}
+
+/*
+ * kpk_probe:
+ * Returns 1 if the side with the pawn wins. The position is turned so that side is White
+ * with its pawn moving up the board, and mirrored so the pawn is on files a-d.
+ */
+int kpk_probe(int strongSide, int strongKing, int weakKing, int pawn, int sideToMove) {
+    if (strongSide == SIDE_BLACK) {
+        strongKing ^= 56;
+        weakKing ^= 56;
+        pawn ^= 56;
+        sideToMove = (sideToMove == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+    }
+    if (COL_OF(pawn) > 3) {
+        strongKing ^= 7;
+        weakKing ^= 7;
+        pawn ^= 7;
+    }
+    int index = kpk_index(sideToMove, strongKing, weakKing, pawn);
+    return (kpkBitbase[index >> 5] >> (index & 31)) & 1;
+}
+
+/*
+ * kpk_score:
+ * For a king and pawn against king, sets *score from White's view and returns 1: zero
+ * for a draw, or a known win that grows as the pawn advances with its king in front.
+ * Returns 0 for any other material.
+ */
+int kpk_score(const Position* pos, int* score) {
+    const BoardState* board = &pos->board;
+    if (popcount(board->occupied) != 3 || popcount(board->pieces[SIDE_WHITE][PAWN] | board->pieces[SIDE_BLACK][PAWN]) != 1)
+        return 0;
+    int strongSide = board->pieces[SIDE_WHITE][PAWN] ? SIDE_WHITE : SIDE_BLACK;
+    int weakSide = (strongSide == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+    int pawn = lsb_index(board->pieces[strongSide][PAWN]);
+    // The bitbase only covers pawns on ranks 2 to 7.
+    if (ROW_OF(pawn) == 0 || ROW_OF(pawn) == BOARD_DIM - 1)
+        return 0;
+    int strongKing = lsb_index(board->pieces[strongSide][KING]);
+    int weakKing = lsb_index(board->pieces[weakSide][KING]);
+    if (!kpk_probe(strongSide, strongKing, weakKing, pawn, pos->sideToMove)) {
+        *score = 0;
+        return 1;
+    }
+    int advance = (strongSide == SIDE_WHITE) ? 6 - ROW_OF(pawn) : ROW_OF(pawn) - 1;
+    int front = (strongSide == SIDE_WHITE) ? pawn - 8 : pawn + 8;
+    int value = KNOWN_WIN + 100 + 20 * advance - square_distance(strongKing, front);
+    *score = (strongSide == SIDE_WHITE) ? value : -value;
+    return 1;
+}
+
+/*
+ * mop_up_score:
+ * King and queen or king and rook against a lone king is always won but has no pawn to
+ * push, so material alone gives the search nothing to aim for. Scores it as a known win
+ * that rises as the lone king is driven to the edge and the kings close in. Returns 0
+ * for any other material.
+ */
+int mop_up_score(const Position* pos, int* score) {
+    const BoardState* board = &pos->board;
+    if (popcount(board->occupied) != 3)
+        return 0;
+    for (int strongSide = SIDE_WHITE; strongSide <= SIDE_BLACK; strongSide++) {
+        const Bitboard* strong = board->pieces[strongSide];
+        int weakSide = (strongSide == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+        if (!(strong[QUEEN] | strong[ROOK]) || popcount(board->occupancy[strongSide]) != 2)
+            continue;
+        int strongKing = lsb_index(strong[KING]);
+        int weakKing = lsb_index(board->pieces[weakSide][KING]);
+        int row = ROW_OF(weakKing), col = COL_OF(weakKing);
+        int edgeDistance = (row < 4 ? row : 7 - row) + (col < 4 ? col : 7 - col);
+        int value = KNOWN_WIN + (strong[QUEEN] ? 900 : 500) + 20 * (6 - edgeDistance) -
+            10 * square_distance(strongKing, weakKing);
+        *score = (strongSide == SIDE_WHITE) ? value : -value;
+        return 1;
+    }
+    return 0;
+}
+
+// Pawn structure terms (middlegame, endgame). Passed pawn bonuses are by rank from the
+// pawn's own side, and a king on its first two ranks loses SHELTER_* for each file
+// beside or in front of it that lacks a pawn close by.
+#define DOUBLED_PAWN_MG 10
+#define DOUBLED_PAWN_EG 20
+#define ISOLATED_PAWN_MG 10
+#define ISOLATED_PAWN_EG 15
+#define BACKWARD_PAWN_MG 8
+#define BACKWARD_PAWN_EG 10
+#define SHELTER_ADVANCED 8
+#define SHELTER_MISSING 20
+static const int passedPawnMg[BOARD_DIM] = { 0, 5, 10, 15, 25, 45, 70, 0 };
+static const int passedPawnEg[BOARD_DIM] = { 0, 10, 15, 30, 50, 80, 120, 0 };
+
+/*
+ * Pawn hash:
+ * Pawn structure changes far less often than the rest of the position, so its terms are
+ * cached by the pawn-only key. The king shelter also depends on where the king stands;
+ * an entry keeps it for the last king square of each side that it was asked about.
+ */
+#define PAWN_HASH_ENTRIES 16384     // A power of two.
+
+typedef struct {
+    HashKey key;
+    short mg, eg;                   // Pawn structure from White's view.
+    signed char shelterKing[2];     // King square each side's shelter was computed for, -1 if none.
+    short shelter[2];               // That shelter, as a middlegame penalty for the side.
+} PawnEntry;
+
+typedef struct {
+    PawnEntry entries[PAWN_HASH_ENTRIES];
+    long long probes;
+    long long hits;
+} PawnTable;
+
+/*
+ * evaluate_pawns:
+ * Doubled, isolated, backward and passed pawns of both sides, from White's view.
+ */
+void evaluate_pawns(const BoardState* board, PawnEntry* entry) {
+    int mg = 0, eg = 0;
+    for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+        int opponent = (side == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+        int sign = (side == SIDE_WHITE) ? 1 : -1;
+        Bitboard own = board->pieces[side][PAWN], enemy = board->pieces[opponent][PAWN];
+        Bitboard pawns = own;
+        while (pawns) {
+            int sq = pop_lsb(&pawns);
+            int col = COL_OF(sq);
+            int rank = (side == SIDE_WHITE) ? 7 - ROW_OF(sq) : ROW_OF(sq);
+            int stop = (side == SIDE_WHITE) ? sq - 8 : sq + 8;
+            if (!(own & adjacentFiles[col])) {
+                mg -= sign * ISOLATED_PAWN_MG;
+                eg -= sign * ISOLATED_PAWN_EG;
+            }
+            else if (!(own & pawnSupportMask[side][sq]) && (pawnAttacks[side][stop] & enemy)) {
+                mg -= sign * BACKWARD_PAWN_MG;
+                eg -= sign * BACKWARD_PAWN_EG;
+            }
+            if (!(enemy & passedPawnMask[side][sq])) {
+                mg += sign * passedPawnMg[rank];
+                eg += sign * passedPawnEg[rank];
+            }
+        }
+        for (int col = 0; col < BOARD_DIM; col++) {
+            int count = popcount(own & fileBB[col]);
+            if (count > 1) {
+                mg -= sign * DOUBLED_PAWN_MG * (count - 1);
+                eg -= sign * DOUBLED_PAWN_EG * (count - 1);
+            }
+        }
+    }
+    entry->mg = (short)mg;
+    entry->eg = (short)eg;
+    entry->shelterKing[SIDE_WHITE] = entry->shelterKing[SIDE_BLACK] = -1;
+}
+
+/*
+ * king_shelter:
+ * Middlegame penalty for a side's king on its first two ranks: for its own file and the
+ * ones beside it, nothing for a pawn one rank ahead, SHELTER_ADVANCED for one two ranks
+ * ahead and SHELTER_MISSING otherwise.
+ */
+int king_shelter(const BoardState* board, int side, int kingSquare) {
+    int rank = (side == SIDE_WHITE) ? 7 - ROW_OF(kingSquare) : ROW_OF(kingSquare);
+    if (rank > 1)
+        return 0;
+    int step = (side == SIDE_WHITE) ? -1 : 1;
+    int penalty = 0;
+    for (int col = COL_OF(kingSquare) - 1; col <= COL_OF(kingSquare) + 1; col++) {
+        if (col < 0 || col >= BOARD_DIM)
+            continue;
+        Bitboard pawns = board->pieces[side][PAWN] & fileBB[col];
+        if (pawns & ROW_BB(ROW_OF(kingSquare) + step))
+            continue;
+        penalty += (pawns & ROW_BB(ROW_OF(kingSquare) + 2 * step)) ? SHELTER_ADVANCED : SHELTER_MISSING;
+    }
+    return penalty;
+}
+
+/*
+ * probe_pawns:
+ * The pawn entry for the position with each side's shelter filled in for where its king
+ * stands, computed and stored on a miss.
+ */
+PawnEntry* probe_pawns(const Position* pos, PawnTable* table) {
+    PawnEntry* entry = &table->entries[pos->pawnKey & (PAWN_HASH_ENTRIES - 1)];
+    table->probes++;
+    if (entry->key == pos->pawnKey && entry->shelterKing[SIDE_WHITE] != -1)
+        table->hits++;
+    else {
+        evaluate_pawns(&pos->board, entry);
+        entry->key = pos->pawnKey;
+    }
+    for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+        int kingSquare = lsb_index(pos->board.pieces[side][KING]);
+        if (entry->shelterKing[side] != kingSquare) {
+            entry->shelterKing[side] = (signed char)kingSquare;
+            entry->shelter[side] = (short)king_shelter(&pos->board, side, kingSquare);
+        }
+    }
+    return entry;
+}
+
+/*
+ * evaluate_board:
+ * Material, piece-square and pawn structure evaluation from White's point of view,
+ * blended between the middlegame and endgame sums by the remaining material. The
+ * material and piece-square sums are kept up to date as pieces move, and the pawn terms
+ * come from the pawn hash when one is given. With three pieces left the endgame
+ * knowledge above takes over.
+ */
+int evaluate_board(const Position* pos, PawnTable* pawnHash) {
+    int score;
+    if (popcount(pos->board.occupied) == 3 && (kpk_score(pos, &score) || mop_up_score(pos, &score)))
+        return score;
+    PawnEntry scratch;
+    PawnEntry* pawns = &scratch;
+    if (pawnHash)
+        pawns = probe_pawns(pos, pawnHash);
+    else {
+        evaluate_pawns(&pos->board, pawns);
+        for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+            pawns->shelter[side] = (short)king_shelter(&pos->board, side, lsb_index(pos->board.pieces[side][KING]));
+    }
+    int mg = pos->mgScore + pawns->mg - pawns->shelter[SIDE_WHITE] + pawns->shelter[SIDE_BLACK];
+    int eg = pos->egScore + pawns->eg;
+    int phase = (pos->phase < TOTAL_PHASE) ? pos->phase : TOTAL_PHASE;
+    return (mg * phase + eg * (TOTAL_PHASE - phase)) / TOTAL_PHASE;
+}
+
+/*
+ * Evaluation cache:
+ * Each search thread's pawn hash, and a small always-replace cache of whole evaluations
+ * by position key so a leaf reached again by transposition costs one lookup.
+ */
+#define EVAL_CACHE_ENTRIES 32768    // A power of two.
+
+typedef struct {
+    HashKey key;
+    int score;
+} EvalCacheEntry;
+
+typedef struct {
+    PawnTable pawns;
+    EvalCacheEntry evals[EVAL_CACHE_ENTRIES];
+} EvalCache;
+
+EvalCache* eval_cache_new() {
+    EvalCache* cache = (EvalCache*)calloc(1, sizeof(EvalCache));
+    if (!cache)
+        return NULL;
+    for (int i = 0; i < PAWN_HASH_ENTRIES; i++)
+        cache->pawns.entries[i].shelterKing[SIDE_WHITE] = -1;
+    // A zero key would otherwise match the empty entries.
+    for (int i = 0; i < EVAL_CACHE_ENTRIES; i++)
+        cache->evals[i].key = ~0ULL;
+    return cache;
+}
+
+/*
+ * Transposition table:
+ * A fixed-size cache of search results keyed by the Zobrist key. Entries are 16 bytes and
+ * grouped four to a 64-byte bucket, so a probe touches a single cache line.
+ *
+ * The table is shared by all search threads without locks. An entry is two words, the
+ * packed data and the key XORed with that data; a probe only accepts the entry when the
+ * two still agree, so a write torn by another thread reads as a miss.
+ */
+#define TT_BUCKET_SIZE 4
+#define DEFAULT_HASH_MB 16
+
+#define BOUND_NONE 0
+#define BOUND_UPPER 1   // Score is at most this (search failed low).
+#define BOUND_LOWER 2   // Score is at least this (search failed high).
+#define BOUND_EXACT 3
+
+typedef struct {
+    std::atomic<unsigned long long> check;  // key ^ data
+    std::atomic<unsigned long long> data;   // Packed by tt_pack.
+} TTEntry;
+
+// An entry's contents, unpacked.
+typedef struct {
+    unsigned short move;   // Best move, packed with pack_move (0 if none).
+    int score;
+    int depth;
+    int bound;
+    int generation;
+} TTData;
+
+typedef struct {
+    TTEntry entries[TT_BUCKET_SIZE];
+} TTBucket;
+
+// Header of a table kept in a file (--tt-file). It takes a whole page, so the buckets
+// after it stay cache-line aligned, and is checked against this build before the
+// entries are trusted.
+#define TT_FILE_MAGIC "CGVAI-TT"
+#define TT_FILE_VERSION 1
+#define TT_FILE_HEADER_SIZE 4096
+
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    unsigned int entrySize;
+    unsigned int bucketSize;
+    unsigned int generation;        // Generation of the last search.
+    unsigned long long bucketCount;
+    unsigned long long keyCheck;    // Fingerprint of the Zobrist keys the entries were stored under.
+    unsigned long long searches;    // Searches run on the table since it was created.
+    long long created;              // time() of creation and of the last search.
+    long long lastUsed;
+} TTFileHeader;
+
+// An open table file. It stays open while the table is mapped, to hold its lock.
+#if defined(_WIN32)
+typedef HANDLE TableFile;
+#define NO_TABLE_FILE INVALID_HANDLE_VALUE
+#else
+typedef int TableFile;
+#define NO_TABLE_FILE -1
+#endif
+
+typedef struct {
+    TTBucket* buckets;
+    void* allocation;      // Unaligned block backing buckets, when in memory.
+    TTFileHeader* file;    // Mapped file backing buckets, when kept in a file,
+    TableFile fileHandle;  // and the file itself.
+    size_t mappedSize;
+    size_t bucketCount;    // Always a power of two.
+    std::atomic<unsigned char> generation;
+    std::mutex headerLock; // Serialises the file header updates of threads sharing the table.
+} TranspositionTable;
+
+TranspositionTable transTable;
+
+/*
+ * pack_move / unpack_move:
+ * Squeeze a move into 16 bits for the table: source (6), destination (6) and promotion (3).
+ */
+unsigned short pack_move(ChessMove move) {
+    int promotion = 0;
+    switch (tolower(move.promoteTo)) {
+    case 'n': promotion = 1; break;
+    case 'b': promotion = 2; break;
+    case 'r': promotion = 3; break;
+    case 'q': promotion = 4; break;
+    }
+    return (unsigned short)(SQUARE_OF(move.src_row, move.src_col) |
+        (SQUARE_OF(move.dst_row, move.dst_col) << 6) | (promotion << 12));
+}
+
+ChessMove unpack_move(unsigned short packed) {
+    ChessMove move;
+    int src = packed & 63, dst = (packed >> 6) & 63;
+    move.src_row = ROW_OF(src); move.src_col = COL_OF(src);
+    move.dst_row = ROW_OF(dst); move.dst_col = COL_OF(dst);
+    // Promotions land on row 0 for White (uppercase) and row 7 for Black.
+    move.promoteTo = "\0nbrq"[(packed >> 12) & 7];
+    if (move.promoteTo && move.dst_row == 0)
+        move.promoteTo = (char)toupper(move.promoteTo);
+    return move;
+}
+
+/*
+ * tt_resize / tt_clear:
+ * (Re)allocate the table to the largest power-of-two bucket count that fits in sizeMB,
+ * and wipe its contents.
+ */
+void tt_clear(TranspositionTable* tt) {
+    memset((void*)tt->buckets, 0, tt->bucketCount * sizeof(TTBucket));
+    tt->generation = 0;
+    if (tt->file)
+        tt->file->generation = 0;
+}
+
+int tt_resize(TranspositionTable* tt, size_t sizeMB) {
+    // A table kept in a file keeps the file's size.
+    if (tt->file)
+        return 1;
+    size_t count = 1;
+    while (count * 2 * sizeof(TTBucket) <= sizeMB * 1024 * 1024)
+        count *= 2;
+    void* allocation = malloc(count * sizeof(TTBucket) + 63);
+    if (!allocation) return 0;
+    free(tt->allocation);
+    tt->allocation = allocation;
+    tt->buckets = (TTBucket*)(((size_t)allocation + 63) & ~(size_t)63);
+    tt->bucketCount = count;
+    tt_clear(tt);
+    return 1;
+}
+
+/*
+ * tt_new_search:
+ * Ages the table so entries from earlier searches are replaced first. Workers sharing a
+ * table start searches concurrently, so the file header is updated under a lock and
+ * always records the newest generation, whichever thread gets there first.
+ */
+void tt_new_search(TranspositionTable* tt) {
+    tt->generation.fetch_add(1);
+    if (tt->file) {
+        std::lock_guard<std::mutex> guard(tt->headerLock);
+        tt->file->generation = tt->generation.load();
+        tt->file->searches++;
+        tt->file->lastUsed = (long long)time(NULL);
+    }
+}
+
+/*
+ * open_table_file / close_table_file:
+ * Open a table file for reading, or for reading and writing (creating it if it is
+ * missing), and close it again, which also drops its lock.
+ */
+static TableFile open_table_file(const char* path, int writable) {
+#if defined(_WIN32)
+    return CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, writable ? OPEN_ALWAYS : OPEN_EXISTING, 0, NULL);
+#else
+    return open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+#endif
+}
+
+static void close_table_file(TableFile file) {
+#if defined(_WIN32)
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+/*
+ * lock_table_file:
+ * Takes the file's advisory lock, shared or exclusive, converting the one already held.
+ * Every process that maps a table holds it shared for as long as it does, so the
+ * exclusive lock is only granted when nobody else is using the file. Without `wait`
+ * it fails at once instead of waiting. Returns 0 on failure.
+ */
+static int lock_table_file(TableFile file, int exclusive, int wait) {
+#if defined(_WIN32)
+    // Windows locks byte ranges and cannot convert a lock, so one byte far past the end
+    // of any table is unlocked and locked again.
+    OVERLAPPED range;
+    memset(&range, 0, sizeof(range));
+    range.OffsetHigh = 0x40000000;
+    UnlockFileEx(file, 0, 1, 0, &range);
+    return LockFileEx(file, (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY),
+        0, 1, 0, &range) != 0;
+#else
+    return flock(file, (exclusive ? LOCK_EX : LOCK_SH) | (wait ? 0 : LOCK_NB)) == 0;
+#endif
+}
+
+/*
+ * table_file_size / resize_table_file:
+ * The file's size, and emptying it and growing it to `size`, which leaves it all zeros.
+ */
+static size_t table_file_size(TableFile file) {
+#if defined(_WIN32)
+    LARGE_INTEGER length;
+    return GetFileSizeEx(file, &length) ? (size_t)length.QuadPart : 0;
+#else
+    struct stat info;
+    return fstat(file, &info) ? 0 : (size_t)info.st_size;
+#endif
+}
+
+static int resize_table_file(TableFile file, size_t size) {
+#if defined(_WIN32)
+    LARGE_INTEGER length;
+    length.QuadPart = 0;
+    if (!SetFilePointerEx(file, length, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+        return 0;
+    length.QuadPart = (LONGLONG)size;
+    return SetFilePointerEx(file, length, NULL, FILE_BEGIN) && SetEndOfFile(file);
+#else
+    return !ftruncate(file, 0) && !ftruncate(file, (off_t)size);
+#endif
+}
+
+/*
+ * map_table_file / unmap_table_file:
+ * Map the first `size` bytes of a file shared, read-only or writable, and unmap them.
+ */
+static void* map_table_file(TableFile file, int writable, size_t size) {
+#if defined(_WIN32)
+    HANDLE mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return NULL;
+    void* view = MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    return view;
+#else
+    void* view = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+    return view == MAP_FAILED ? NULL : view;
+#endif
+}
+
+static void unmap_table_file(void* view, size_t size) {
+#if defined(_WIN32)
+    FlushViewOfFile(view, size);
+    UnmapViewOfFile(view);
+#else
+    msync(view, size, MS_SYNC);
+    munmap(view, size);
+#endif
+}
+
+/*
+ * zobrist_fingerprint:
+ * Folds every Zobrist key into one number, so a table file written with other keys is
+ * recognised and not read as this build's entries.
+ */
+unsigned long long zobrist_fingerprint() {
+    unsigned long long check = 0;
+    const HashKey* tables[] = { &zobristPieces[0][0][0], zobristCastling, zobristEnPassant, &zobristBlackToMove };
+    const size_t counts[] = { 2 * PIECE_TYPES * BOARD_SQUARES, 16, BOARD_DIM, 1 };
+    for (int t = 0; t < 4; t++)
+        for (size_t i = 0; i < counts[t]; i++)
+            check = (check << 7 | check >> 57) ^ tables[t][i];
+    return check;
+}
+
+/*
+ * tt_file_problem:
+ * Why a file that starts like a table file cannot be used by this build, or NULL if it
+ * can. A file cut short while it was being created has no magic yet and is reported
+ * as such; anything else without the magic is not a table file at all.
+ */
+static const char notATableFile[] = "it is not a transposition table file";
+
+static const char* tt_file_problem(const TTFileHeader* header, size_t fileSize) {
+    static const char noMagic[8] = { 0 };
+    if (fileSize < TT_FILE_HEADER_SIZE || (memcmp(header->magic, TT_FILE_MAGIC, 8) && memcmp(header->magic, noMagic, 8)))
+        return notATableFile;
+    if (memcmp(header->magic, TT_FILE_MAGIC, 8))
+        return "its creation was not completed";
+    if (header->version != TT_FILE_VERSION)
+        return "it was written for another version of the format";
+    if (header->entrySize != sizeof(TTEntry) || header->bucketSize != TT_BUCKET_SIZE)
+        return "its entries have another layout";
+    if (header->keyCheck != zobrist_fingerprint())
+        return "it was written with other hash keys";
+    if (!header->bucketCount || (header->bucketCount & (header->bucketCount - 1)) ||
+        header->bucketCount > (fileSize - TT_FILE_HEADER_SIZE) / sizeof(TTBucket) ||
+        fileSize != TT_FILE_HEADER_SIZE + header->bucketCount * sizeof(TTBucket))
+        return "its size does not match its header";
+    return NULL;
+}
+
+/*
+ * tt_open_file:
+ * Backs the table with a memory-mapped file, so its contents outlive the process. A
+ * usable file is used as it is, at its own size, and *warm is set. A missing or empty
+ * file becomes an empty table of sizeMB. A table file this build cannot use (another
+ * format version, layout or set of keys, or an unfinished one) is only replaced when
+ * `recreate` is set, and never while another process has it open; any other file is
+ * left alone. Entries are checked against their key as they are read, so one left
+ * half-written by a process that died is simply a miss. Reports why and returns 0 if
+ * the file cannot be used.
+ */
+int tt_open_file(TranspositionTable* tt, const char* path, size_t sizeMB, int recreate, int* warm) {
+    TableFile file = open_table_file(path, 1);
+    if (file == NO_TABLE_FILE) {
+        fprintf(stderr, "Could not open %s.\n", path);
+        return 0;
+    }
+    // The file is looked at under the shared lock. If a table has to be created it is
+    // looked at again under the exclusive one, as another process may have created it
+    // in between.
+    lock_table_file(file, 0, 1);
+    int exclusive = 0;
+    size_t size = 0;
+    void* view = NULL;
+    while (1) {
+        size = table_file_size(file);
+        if (size) {
+            view = map_table_file(file, 1, size);
+            if (!view) {
+                fprintf(stderr, "Could not map %s.\n", path);
+                close_table_file(file);
+                return 0;
+            }
+            const char* problem = tt_file_problem((const TTFileHeader*)view, size);
+            if (!problem)
+                break;
+            unmap_table_file(view, size);
+            view = NULL;
+            if (problem == notATableFile || !recreate) {
+                fprintf(stderr, "%s cannot be used: %s.%s\n", path, problem,
+                    problem == notATableFile ? "" : " --tt-recreate replaces it with an empty table.");
+                close_table_file(file);
+                return 0;
+            }
+        }
+        if (exclusive)
+            break;
+        if (!lock_table_file(file, 1, 0)) {
+            fprintf(stderr, "%s is in use by another process and cannot be recreated.\n", path);
+            close_table_file(file);
+            return 0;
+        }
+        exclusive = 1;
+    }
+
+    *warm = view != NULL;
+    if (!view) {
+        // Nobody else has the file open while the exclusive lock is held, so it can be
+        // truncated without pulling the pages from under another process.
+        size_t count = 1;
+        while (count * 2 * sizeof(TTBucket) <= sizeMB * 1024 * 1024)
+            count *= 2;
+        size = TT_FILE_HEADER_SIZE + count * sizeof(TTBucket);
+        if (!resize_table_file(file, size) || !(view = map_table_file(file, 1, size))) {
+            fprintf(stderr, "Could not create %s.\n", path);
+            close_table_file(file);
+            return 0;
+        }
+        // The magic goes in last, so a file whose creation was cut short is not valid.
+        TTFileHeader* header = (TTFileHeader*)view;
+        header->version = TT_FILE_VERSION;
+        header->entrySize = sizeof(TTEntry);
+        header->bucketSize = TT_BUCKET_SIZE;
+        header->bucketCount = count;
+        header->keyCheck = zobrist_fingerprint();
+        header->created = header->lastUsed = (long long)time(NULL);
+        memcpy(header->magic, TT_FILE_MAGIC, 8);
+    }
+    if (exclusive)
+        lock_table_file(file, 0, 1);
+    free(tt->allocation);
+    tt->allocation = NULL;
+    tt->file = (TTFileHeader*)view;
+    tt->fileHandle = file;
+    tt->mappedSize = size;
+    tt->buckets = (TTBucket*)((char*)view + TT_FILE_HEADER_SIZE);
+    tt->bucketCount = (size_t)tt->file->bucketCount;
+    tt->generation = (unsigned char)tt->file->generation;
+    return 1;
+}
+
+/*
+ * tt_release:
+ * Frees the table, or writes back and unmaps its file.
+ */
+void tt_release(TranspositionTable* tt) {
+    if (tt->file) {
+        unmap_table_file(tt->file, tt->mappedSize);
+        close_table_file(tt->fileHandle);
+    }
+    else
+        free(tt->allocation);
+    tt->file = NULL;
+    tt->allocation = NULL;
+    tt->buckets = NULL;
+}
+
+/*
+ * tt_pack / tt_unpack:
+ * Data word layout: move (bits 0-15), score (16-31), depth (32-39), bound (40-41),
+ * generation (48-55).
+ */
+static inline unsigned long long tt_pack(unsigned short move, int score, int depth, int bound, int generation) {
+    return (unsigned long long)move | ((unsigned long long)(unsigned short)(short)score << 16) |
+        ((unsigned long long)(depth & 0xFF) << 32) | ((unsigned long long)bound << 40) |
+        ((unsigned long long)(generation & 0xFF) << 48);
+}
+
+static inline TTData tt_unpack(unsigned long long data) {
+    TTData out;
+    out.move = (unsigned short)data;
+    out.score = (short)(unsigned short)(data >> 16);
+    out.depth = (int)((data >> 32) & 0xFF);
+    out.bound = (int)((data >> 40) & 3);
+    out.generation = (int)((data >> 48) & 0xFF);
+    return out;
+}
+
+/*
+ * tt_probe:
+ * Copies out the entry stored for this key and returns 1, or returns 0 on a miss.
+ */
+int tt_probe(TranspositionTable* tt, HashKey key, TTData* out) {
+    TTBucket* bucket = &tt->buckets[key & (tt->bucketCount - 1)];
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        unsigned long long data = bucket->entries[i].data.load(std::memory_order_relaxed);
+        unsigned long long check = bucket->entries[i].check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && data) {
+            *out = tt_unpack(data);
+            if (out->bound != BOUND_NONE)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * tt_store:
+ * Saves a search result. The same key is overwritten in place; otherwise the entry
+ * from the oldest search with the shallowest depth is replaced.
+ */
+void tt_store(TranspositionTable* tt, HashKey key, int depth, int bound, int score, unsigned short move) {
+    TTBucket* bucket = &tt->buckets[key & (tt->bucketCount - 1)];
+    TTEntry* replace = NULL;
+    int replaceWorth = 0;
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        TTEntry* entry = &bucket->entries[i];
+        unsigned long long data = entry->data.load(std::memory_order_relaxed);
+        TTData old = tt_unpack(data);
+        if (!data || (entry->check.load(std::memory_order_relaxed) ^ data) == key) {
+            // Keep the old best move if this search did not find one.
+            if (!move && data)
+                move = old.move;
+            replace = entry;
+            break;
+        }
+        int worth = old.depth - 8 * (unsigned char)(tt->generation - old.generation);
+        if (!replace || worth < replaceWorth) {
+            replace = entry;
+            replaceWorth = worth;
+        }
+    }
+    unsigned long long data = tt_pack(move, score, depth, bound, tt->generation);
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+/*
+ * tt_file_report:
+ * The "ttinfo" tool: prints a table file's header, how full it is, how many searches
+ * ago its entries were stored and how deep they are. Returns 0 if the file is missing
+ * or not a valid table for this build.
+ */
+int tt_file_report(const char* path) {
+    // The shared lock keeps another process from recreating the file while it is read.
+    TableFile file = open_table_file(path, 0);
+    size_t size = 0;
+    void* view = NULL;
+    if (file != NO_TABLE_FILE && lock_table_file(file, 0, 1) && (size = table_file_size(file)) != 0)
+        view = map_table_file(file, 0, size);
+    if (!view) {
+        printf("Could not open %s.\n", path);
+        if (file != NO_TABLE_FILE)
+            close_table_file(file);
+        return 0;
+    }
+    const TTFileHeader* header = (const TTFileHeader*)view;
+    const char* problem = tt_file_problem(header, size);
+    if (problem) {
+        printf("%s cannot be used by this build: %s.\n", path, problem);
+        unmap_table_file(view, size);
+        close_table_file(file);
+        return 0;
+    }
+    // Ages in searches: 0, 1, 2-3, 4-7, 8-15, 16-31, 32 and more.
+    static const char* ageNames[] = { "0", "1", "2-3", "4-7", "8-15", "16-31", "32+" };
+    long long byAge[7] = { 0 }, filled = 0, depthSum = 0;
+    int maxDepth = 0;
+    const TTBucket* buckets = (const TTBucket*)((const char*)view + TT_FILE_HEADER_SIZE);
+    for (unsigned long long b = 0; b < header->bucketCount; b++) {
+        for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+            unsigned long long data = buckets[b].entries[i].data.load(std::memory_order_relaxed);
+            TTData entry = tt_unpack(data);
+            if (!data || entry.bound == BOUND_NONE)
+                continue;
+            int age = (unsigned char)(header->generation - entry.generation), bucket = 0;
+            while (bucket < 6 && age >= (1 << bucket))
+                bucket++;
+            byAge[bucket]++;
+            filled++;
+            depthSum += entry.depth;
+            if (entry.depth > maxDepth)
+                maxDepth = entry.depth;
+        }
+    }
+    long long total = (long long)header->bucketCount * TT_BUCKET_SIZE;
+    time_t created = (time_t)header->created, lastUsed = (time_t)header->lastUsed;
+    char createdText[32], lastUsedText[32];
+    strftime(createdText, sizeof(createdText), "%Y-%m-%d %H:%M:%S", localtime(&created));
+    strftime(lastUsedText, sizeof(lastUsedText), "%Y-%m-%d %H:%M:%S", localtime(&lastUsed));
+    printf("file %s  version %u  size %.1f MB  entries %lld\n", path, header->version,
+        size / (1024.0 * 1024.0), total);
+    printf("created %s  last used %s  searches %llu  generation %u\n", createdText, lastUsedText,
+        header->searches, header->generation & 0xFF);
+    printf("filled %lld (%.1f%%)  average depth %.1f  max depth %d\n", filled, 100.0 * filled / total,
+        filled ? (double)depthSum / filled : 0.0, maxDepth);
+    printf("age in searches:");
+    for (int bucket = 0; bucket < 7; bucket++)
+        printf("  %s: %.1f%%", ageNames[bucket], filled ? 100.0 * byAge[bucket] / filled : 0.0);
+    printf("\n");
+    unmap_table_file(view, size);
+    close_table_file(file);
+    return 1;
+}
+
+/*
+ * score_to_tt / score_from_tt:
+ * Mate scores are stored relative to the node rather than the root, so they stay
+ * correct when the same position is reached at a different ply.
+ */
+int score_to_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+int score_from_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+/*
+ * same_move:
+ * Compares two moves field by field.
+ */
+int same_move(ChessMove a, ChessMove b) {
+    return a.src_row == b.src_row && a.src_col == b.src_col &&
+        a.dst_row == b.dst_row && a.dst_col == b.dst_col && a.promoteTo == b.promoteTo;
+}
+
+/*
+ * is_null_move:
+ * True for an empty move: no move found, or a null move on the undo stack.
+ */
+int is_null_move(ChessMove move) {
+    return move.src_row == move.dst_row && move.src_col == move.dst_col;
+}
+
+/*
+ * is_repetition:
+ * True if the position has occurred at least `times` times before, in the game or on the
+ * search path. The undo stack holds the key before every move, so only the keys since
+ * the last capture or pawn move (the halfmove clock) with the same side to move are
+ * compared. A null move ends the scan, since positions on either side of it are not
+ * a real repetition.
+ */
+int is_repetition(const Position* pos, int times) {
+    int oldest = pos->undoCount - pos->halfmoveClock;
+    if (oldest < 0)
+        oldest = 0;
+    for (int i = pos->undoCount - 1; i >= oldest; i--) {
+        if (is_null_move(pos->undoStack[i].move))
+            return 0;
+        if (!((pos->undoCount - i) & 1) && pos->undoStack[i].key == pos->key && --times == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * make_game_move:
+ * Plays a move of the game with make_move, so it stays on the undo stack for repetition
+ * checks. When the stack is close to full only the last FIFTY_MOVE_PLIES entries are
+ * kept to leave room for the search: anything older is from before the last capture or
+ * pawn move, or the fifty-move rule has already drawn the game.
+ */
+void make_game_move(Position* pos, ChessMove move) {
+    make_move(pos, move);
+    if (pos->undoCount > MAX_UNDO - 2 * MAX_PLY) {
+        int keep = (pos->halfmoveClock < FIFTY_MOVE_PLIES) ? pos->halfmoveClock : FIFTY_MOVE_PLIES;
+        memmove(pos->undoStack, pos->undoStack + pos->undoCount - keep, keep * sizeof(UndoInfo));
+        pos->undoCount = keep;
+    }
+}
+
+/*
+ * now_ms:
+ * Monotonic wall-clock time in milliseconds.
+ */
+long long now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Limits for one search. Zero means no limit of that kind.
+typedef struct {
+    int maxDepth;
+    long long maxNodes;
+    long long moveTimeMs;
+} SearchLimits;
+
+// Most search threads choose_best_move will run.
+#define MAX_THREADS 256
+
+// Search techniques that can be switched off (SearchInfo.disabledFeatures) to measure
+// what each one saves.
+#define FEATURE_PVS 1               // Zero-window search of all but the first move.
+#define FEATURE_NULL_MOVE 2         // Verified null-move pruning.
+#define FEATURE_LMR 4               // Late move reductions.
+#define FEATURE_CHECK_EXTENSION 8   // Search one ply deeper when in check.
+
+// Search counters for one ply. Every thread keeps its own and choose_best_move adds the
+// helpers' into the main thread's when the search ends, so counting costs no more than
+// an increment.
+typedef struct {
+    long long nodes;            // minimax calls.
+    long long qnodes;           // quiescence calls.
+    long long evals;            // Static evaluations,
+    long long evalCacheHits;    // those answered by the evaluation cache,
+    long long pawnProbes;       // and the pawn hash lookups of the rest.
+    long long pawnHits;
+    long long pickerNodes;      // Nodes whose moves came from the move picker,
+    long long movesGenerated;   // the moves generated at those nodes
+    long long movesSearched;    // and how many of them were searched.
+    long long betaCutoffs;
+    long long firstMoveCutoffs; // Cutoffs caused by the first move searched.
+    long long ttProbes;
+    long long ttHits;
+    long long ttCutoffs;        // Nodes answered by the hash entry alone.
+    long long nullMoveTries;
+    long long nullMoveCutoffs;
+    long long reductions;       // Late moves searched at reduced depth,
+    long long researches;       // and those searched again at full depth.
+    long long draws;            // Nodes ended as a repetition or by the fifty-move rule.
+} PlyStats;
+
+typedef struct {
+    PlyStats ply[MAX_PLY];
+    long long iterationNodes[MAX_PLY]; // Main thread: minimax + quiescence calls when each depth completed.
+} SearchStats;
+
+// The PlyStats fields by name, for adding them up and for the JSON export.
+static const struct {
+    const char* name;
+    size_t offset;
+} plyStatFields[] = {
+    { "nodes", offsetof(PlyStats, nodes) },
+    { "qnodes", offsetof(PlyStats, qnodes) },
+    { "evals", offsetof(PlyStats, evals) },
+    { "eval_cache_hits", offsetof(PlyStats, evalCacheHits) },
+    { "pawn_probes", offsetof(PlyStats, pawnProbes) },
+    { "pawn_hits", offsetof(PlyStats, pawnHits) },
+    { "picker_nodes", offsetof(PlyStats, pickerNodes) },
+    { "moves_generated", offsetof(PlyStats, movesGenerated) },
+    { "moves_searched", offsetof(PlyStats, movesSearched) },
+    { "beta_cutoffs", offsetof(PlyStats, betaCutoffs) },
+    { "first_move_cutoffs", offsetof(PlyStats, firstMoveCutoffs) },
+    { "tt_probes", offsetof(PlyStats, ttProbes) },
+    { "tt_hits", offsetof(PlyStats, ttHits) },
+    { "tt_cutoffs", offsetof(PlyStats, ttCutoffs) },
+    { "null_move_tries", offsetof(PlyStats, nullMoveTries) },
+    { "null_move_cutoffs", offsetof(PlyStats, nullMoveCutoffs) },
+    { "reductions", offsetof(PlyStats, reductions) },
+    { "researches", offsetof(PlyStats, researches) },
+    { "draws", offsetof(PlyStats, draws) },
+};
+#define PLY_STAT_FIELDS ((int)(sizeof(plyStatFields) / sizeof(plyStatFields[0])))
+
+static inline long long* ply_stat(PlyStats* stats, int field) {
+    return (long long*)((char*)stats + plyStatFields[field].offset);
+}
+
+/*
+ * stats_add / stats_total:
+ * Add one set of counters into another, and sum a search's counters over all plies.
+ */
+void stats_add(SearchStats* total, const SearchStats* stats, int withIterations) {
+    for (int ply = 0; ply < MAX_PLY; ply++)
+        for (int field = 0; field < PLY_STAT_FIELDS; field++)
+            *ply_stat(&total->ply[ply], field) += *ply_stat((PlyStats*)&stats->ply[ply], field);
+    if (withIterations)
+        for (int depth = 0; depth < MAX_PLY; depth++)
+            total->iterationNodes[depth] += stats->iterationNodes[depth];
+}
+
+PlyStats stats_total(const SearchStats* stats) {
+    PlyStats total;
+    memset(&total, 0, sizeof(total));
+    for (int ply = 0; ply < MAX_PLY; ply++)
+        for (int field = 0; field < PLY_STAT_FIELDS; field++)
+            *ply_stat(&total, field) += *ply_stat((PlyStats*)&stats->ply[ply], field);
+    return total;
+}
+
+// Iterations with fewer nodes were mostly answered from the hash table and say nothing
+// about the branching factor.
+#define EBF_MIN_NODES 1000
+
+static long long iteration_nodes(const SearchStats* stats, int depth) {
+    return stats->iterationNodes[depth] - (depth > 0 ? stats->iterationNodes[depth - 1] : 0);
+}
+
+/*
+ * effective_branching_factor:
+ * Growth in nodes per extra ply: the deepest completed iteration against the latest
+ * earlier one of at least EBF_MIN_NODES nodes, as a geometric mean over the plies between
+ * them. When every earlier iteration came from the table, the search's nodes to the
+ * power 1/depth instead. 0 below depth 2.
+ */
+double effective_branching_factor(const SearchStats* stats) {
+    int depth = MAX_PLY - 1;
+    while (depth > 0 && !stats->iterationNodes[depth])
+        depth--;
+    long long last = iteration_nodes(stats, depth);
+    for (int earlier = depth - 1; earlier >= 1 && last >= EBF_MIN_NODES; earlier--) {
+        long long nodes = iteration_nodes(stats, earlier);
+        if (nodes >= EBF_MIN_NODES)
+            return pow((double)last / nodes, 1.0 / (depth - earlier));
+    }
+    return depth >= 2 ? pow((double)stats->iterationNodes[depth], 1.0 / depth) : 0.0;
+}
+
+// State for one search thread: limits, counters, the stop flag and the principal variation.
+typedef struct SearchInfo {
+    SearchLimits limits;
+    TranspositionTable* tt;
+    int threads;                        // Threads to search with (set on the main thread's info).
+    int threadId;                       // 0 for the main thread, 1.. for helpers.
+    struct SearchInfo* mainThread;      // Helpers: the main thread's info, which owns the flags below.
+    std::atomic<int> stopRequested;     // Main thread: set by the caller (e.g. UCI "stop") to end the search.
+    std::atomic<int> searchDone;        // Main thread: set when it has finished, to end the helpers.
+    std::atomic<long long> helperNodes; // Main thread: nodes searched so far by the helpers, for reporting.
+    std::atomic<int> pondering;         // Main thread: searching on the opponent's time, with no time or node limit yet.
+    std::atomic<long long> limitsStart; // Main thread: when the time budget started (the ponder hit, when pondering).
+    int uciOutput;                      // Print a UCI "info" line after each completed iteration.
+    int disabledFeatures;               // FEATURE_* flags of techniques not to use.
+    int nullMoveDisabled;               // Nonzero inside a null-move verification search.
+    long long startTime;
+    long long nodes;
+    int stopped;
+    int followPv;                       // Still on the previous iteration's PV.
+    ChessMove pv[MAX_PLY][MAX_PLY];     // Triangular PV table: pv[ply] is the line from that ply.
+    int pvLength[MAX_PLY];
+    ChessMove previousPv[MAX_PLY];      // PV of the last completed iteration, searched first.
+    int previousPvLength;
+    ChessMove killers[MAX_PLY][2];      // Quiet moves that caused a cutoff at each ply.
+    int history[2][BOARD_SQUARES][BOARD_SQUARES]; // Cutoff credit for quiet moves, by side, from and to.
+    EvalCache* evalCache;               // This thread's pawn hash and evaluation cache.
+    SearchStats stats;
+    // Result of the last completed iteration.
+    ChessMove bestMove;
+    int bestScore;
+    int completedDepth;
+} SearchInfo;
+
+/*
+ * check_limits:
+ * Polled every 1024 nodes; raises the stop flag once the node or time budget is spent or
+ * a stop was requested. Helper threads only follow the main thread's request. The main
+ * thread always completes depth 1 so there is a move to play. The node budget counts the
+ * main thread's nodes. While pondering only a stop request ends the search.
+ */
+void check_limits(SearchInfo* info) {
+    if (info->nodes & 1023) return;
+    if (info->mainThread) {
+        info->mainThread->helperNodes.fetch_add(1024, std::memory_order_relaxed);
+        if (info->mainThread->stopRequested.load(std::memory_order_relaxed) ||
+            info->mainThread->searchDone.load(std::memory_order_relaxed))
+            info->stopped = 1;
+        return;
+    }
+    if (info->completedDepth == 0) return;
+    if (info->stopRequested.load(std::memory_order_relaxed))
+        info->stopped = 1;
+    else if (info->pondering.load())
+        return;
+    else if ((info->limits.maxNodes && info->nodes >= info->limits.maxNodes) ||
+        (info->limits.moveTimeMs && now_ms() - info->limitsStart.load() >= info->limits.moveTimeMs))
+        info->stopped = 1;
+}
+
+// Material values by piece type, used for capture decisions in the search.
+static const int pieceValues[PIECE_TYPES] = { 100, 320, 330, 500, 900, 20000 };
+
+/*
+ * Move ordering scores. The previous PV move goes first, then the table move, captures by
+ * most valuable victim / least valuable attacker, the two killers, and finally quiet moves
+ * by their history score, which is kept below the killer scores.
+ */
+#define ORDER_PV 4000000
+#define ORDER_HASH 3000000
+#define ORDER_CAPTURE 2000000
+#define ORDER_KILLER_1 1000002
+#define ORDER_KILLER_2 1000001
+#define HISTORY_MAX 1000000
+
+/*
+ * is_quiet:
+ * True for moves that neither capture nor promote.
+ */
+int is_quiet(const Position* pos, ChessMove move) {
+    if (move.promoteTo || pos->board.squares[move.dst_row][move.dst_col] != EMPTY_CELL)
+        return 0;
+    // En passant lands on an empty square.
+    return !(SQUARE_OF(move.dst_row, move.dst_col) == pos->enPassantSquare &&
+             pieceTypeOf(pos->board.squares[move.src_row][move.src_col]) == PAWN);
+}
+
+/*
+ * capture_order:
+ * MVV-LVA ordering value of a capture or promotion: most valuable victim first, then
+ * least valuable attacker, with promotions ranked by the new piece.
+ */
+static int capture_order(const Position* pos, ChessMove move) {
+    char victim = pos->board.squares[move.dst_row][move.dst_col];
+    int victimType = (victim == EMPTY_CELL) ? PAWN : pieceTypeOf(victim);
+    int attackerType = pieceTypeOf(pos->board.squares[move.src_row][move.src_col]);
+    int order = 16 * victimType - attackerType;
+    if (move.promoteTo)
+        order += 16 * pieceTypeOf(move.promoteTo);
+    return order;
+}
+
+/*
+ * score_moves:
+ * Gives every move an ordering score (see above).
+ */
+void score_moves(const Position* pos, SearchInfo* info, unsigned short hashMove, int ply,
+    ChessMove movesList[], int scores[], int numMoves) {
+    int pvMove = info->followPv && ply < info->previousPvLength;
+    for (int i = 0; i < numMoves; i++) {
+        ChessMove move = movesList[i];
+        if (pvMove && same_move(move, info->previousPv[ply]))
+            scores[i] = ORDER_PV;
+        else if (hashMove && pack_move(move) == hashMove)
+            scores[i] = ORDER_HASH;
+        else if (!is_quiet(pos, move))
+            scores[i] = ORDER_CAPTURE + capture_order(pos, move);
+        else if (same_move(move, info->killers[ply][0]))
+            scores[i] = ORDER_KILLER_1;
+        else if (same_move(move, info->killers[ply][1]))
+            scores[i] = ORDER_KILLER_2;
+        else
+            scores[i] = info->history[pos->sideToMove][SQUARE_OF(move.src_row, move.src_col)]
+                                     [SQUARE_OF(move.dst_row, move.dst_col)];
+    }
+}
+
+/*
+ * pick_move:
+ * Selection step: swaps the best-scored move among [index, numMoves) into `index`.
+ * Moves are only sorted as far as the search actually gets.
+ */
+void pick_move(ChessMove movesList[], int scores[], int numMoves, int index) {
+    int best = index;
+    for (int i = index + 1; i < numMoves; i++) {
+        if (scores[i] > scores[best])
+            best = i;
+    }
+    if (best != index) {
+        ChessMove move = movesList[index];
+        int score = scores[index];
+        movesList[index] = movesList[best];
+        scores[index] = scores[best];
+        movesList[best] = move;
+        scores[best] = score;
+    }
+}
+
+/*
+ * see:
+ * Static exchange evaluation: the material the side to move gains from a capture once
+ * both sides have recaptured on the square with their least valuable pieces for as long
+ * as it pays. Sliders behind the exchanged pieces join in as the square opens up.
+ */
+int see(const Position* pos, ChessMove move) {
+    const BoardState* board = &pos->board;
+    int src = SQUARE_OF(move.src_row, move.src_col);
+    int dst = SQUARE_OF(move.dst_row, move.dst_col);
+    char victim = board->squares[move.dst_row][move.dst_col];
+    int gain[32];
+    int depth = 0;
+    gain[0] = (victim == EMPTY_CELL) ? pieceValues[PAWN] : pieceValues[pieceTypeOf(victim)];
+    int attackerType = pieceTypeOf(board->squares[move.src_row][move.src_col]);
+    int side = (pos->sideToMove == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+    Bitboard occupied = board->occupied ^ SQUARE_BB(src);
+    if (victim == EMPTY_CELL)
+        occupied ^= SQUARE_BB(SQUARE_OF(move.src_row, move.dst_col));  // En passant.
+
+    while (depth < 31) {
+        depth++;
+        // What the side to move would be up if it now took the last capturer.
+        gain[depth] = pieceValues[attackerType] - gain[depth - 1];
+        if ((-gain[depth - 1] > gain[depth] ? -gain[depth - 1] : gain[depth]) < 0)
+            break;
+        Bitboard attackers = attackers_to(board, dst, occupied) & occupied & board->occupancy[side];
+        if (!attackers)
+            break;
+        int type = PAWN;
+        while (!(attackers & board->pieces[side][type]))
+            type++;
+        // The king can only recapture if nothing defends the square any more.
+        if (type == KING && (attackers_to(board, dst, occupied) & occupied & board->occupancy[side ^ 1]))
+            break;
+        occupied ^= SQUARE_BB(lsb_index(attackers & board->pieces[side][type]));
+        attackerType = type;
+        side ^= 1;
+    }
+    while (--depth)
+        gain[depth - 1] = -(-gain[depth - 1] > gain[depth] ? -gain[depth - 1] : gain[depth]);
+    return gain[0];
+}
+
+// Stages of the move picker, in the order they are tried.
+#define STAGE_PV 0
+#define STAGE_HASH 1
+#define STAGE_CAPTURES_INIT 2
+#define STAGE_GOOD_CAPTURES 3
+#define STAGE_KILLERS 4
+#define STAGE_QUIETS_INIT 5
+#define STAGE_QUIETS 6
+#define STAGE_BAD_CAPTURES 7
+#define STAGE_DONE 8
+
+// Hands out a node's moves one at a time and generates each group only when the search
+// gets to it, so a cutoff on the hash move or a capture never pays for the quiet moves.
+typedef struct {
+    const Position* pos;
+    SearchInfo* info;
+    int ply;
+    int stage;
+    ChessMove pvMove;
+    ChessMove hashMove;
+    ChessMove tried[4];         // Moves already handed out by the PV, hash and killer stages.
+    int triedCount;
+    int killerIndex;
+    ChessMove moves[MAX_LEGAL_MOVES];
+    int scores[MAX_LEGAL_MOVES];
+    int count, index;
+    ChessMove badCaptures[MAX_LEGAL_MOVES];  // Captures that lose material, tried last.
+    int badCount, badIndex;
+} MovePicker;
+
+void init_move_picker(MovePicker* picker, const Position* pos, SearchInfo* info, int ply, unsigned short hashMove) {
+    picker->pos = pos;
+    picker->info = info;
+    picker->ply = ply;
+    picker->stage = STAGE_PV;
+    memset(&picker->pvMove, 0, sizeof(ChessMove));
+    memset(&picker->hashMove, 0, sizeof(ChessMove));
+    if (info->followPv && ply < info->previousPvLength)
+        picker->pvMove = info->previousPv[ply];
+    if (hashMove)
+        picker->hashMove = unpack_move(hashMove);
+    picker->triedCount = 0;
+    picker->killerIndex = 0;
+    picker->count = picker->index = 0;
+    picker->badCount = picker->badIndex = 0;
+}
+
+static int already_tried(const MovePicker* picker, ChessMove move) {
+    for (int i = 0; i < picker->triedCount; i++)
+        if (same_move(picker->tried[i], move))
+            return 1;
+    return 0;
+}
+
+// A stage's single move is used if it exists, is legal here and was not handed out yet.
+static int try_single_move(MovePicker* picker, ChessMove move) {
+    if (is_null_move(move))
+        return 0;
+    if (already_tried(picker, move) || !move_is_legal(picker->pos, move))
+        return 0;
+    picker->tried[picker->triedCount++] = move;
+    return 1;
+}
+
+/*
+ * next_move:
+ * Sets *move to the next move to search and returns 1, or returns 0 when the node has
+ * no moves left.
+ */
+int next_move(MovePicker* picker, ChessMove* move) {
+    const Position* pos = picker->pos;
+    SearchInfo* info = picker->info;
+    while (1) {
+        switch (picker->stage) {
+        case STAGE_PV:
+            picker->stage = STAGE_HASH;
+            if (try_single_move(picker, picker->pvMove)) {
+                *move = picker->pvMove;
+                return 1;
+            }
+            break;
+
+        case STAGE_HASH:
+            picker->stage = STAGE_CAPTURES_INIT;
+            if (try_single_move(picker, picker->hashMove)) {
+                *move = picker->hashMove;
+                return 1;
+            }
+            break;
+
+        case STAGE_CAPTURES_INIT:
+            picker->count = generateCaptureMoves(pos, picker->moves);
+            info->stats.ply[picker->ply].movesGenerated += picker->count;
+            for (int i = 0; i < picker->count; i++)
+                picker->scores[i] = capture_order(pos, picker->moves[i]);
+            picker->index = 0;
+            picker->stage = STAGE_GOOD_CAPTURES;
+            break;
+
+        case STAGE_GOOD_CAPTURES:
+            while (picker->index < picker->count) {
+                pick_move(picker->moves, picker->scores, picker->count, picker->index);
+                ChessMove candidate = picker->moves[picker->index++];
+                if (already_tried(picker, candidate))
+                    continue;
+                // Captures that lose material wait until after the quiet moves.
+                if (!candidate.promoteTo && see(pos, candidate) < 0) {
+                    picker->badCaptures[picker->badCount++] = candidate;
+                    continue;
+                }
+                *move = candidate;
+                return 1;
+            }
+            picker->stage = STAGE_KILLERS;
+            break;
+
+        case STAGE_KILLERS:
+            while (picker->killerIndex < 2) {
+                ChessMove killer = info->killers[picker->ply][picker->killerIndex++];
+                if (is_quiet(pos, killer) && try_single_move(picker, killer)) {
+                    *move = killer;
+                    return 1;
+                }
+            }
+            picker->stage = STAGE_QUIETS_INIT;
+            break;
+
+        case STAGE_QUIETS_INIT:
+            picker->count = generateQuietMoves(pos, picker->moves);
+            info->stats.ply[picker->ply].movesGenerated += picker->count;
+            for (int i = 0; i < picker->count; i++) {
+                ChessMove quiet = picker->moves[i];
+                picker->scores[i] = info->history[pos->sideToMove][SQUARE_OF(quiet.src_row, quiet.src_col)]
+                                                 [SQUARE_OF(quiet.dst_row, quiet.dst_col)];
+            }
+            picker->index = 0;
+            picker->stage = STAGE_QUIETS;
+            break;
+
+        case STAGE_QUIETS:
+            while (picker->index < picker->count) {
+                pick_move(picker->moves, picker->scores, picker->count, picker->index);
+                ChessMove candidate = picker->moves[picker->index++];
+                if (!already_tried(picker, candidate)) {
+                    *move = candidate;
+                    return 1;
+                }
+            }
+            picker->stage = STAGE_BAD_CAPTURES;
+            break;
+
+        case STAGE_BAD_CAPTURES:
+            if (picker->badIndex < picker->badCount) {
+                *move = picker->badCaptures[picker->badIndex++];
+                return 1;
+            }
+            picker->stage = STAGE_DONE;
+            break;
+
+        default:
+            return 0;
+        }
+    }
+}
+
+/*
+ * update_quiet_stats:
+ * A quiet move caused a cutoff: make it the first killer at this ply and credit its history.
+ * History is halved across the board when any entry grows too large.
+ */
+void update_quiet_stats(SearchInfo* info, int side, int ply, int depth, ChessMove move) {
+    if (!same_move(move, info->killers[ply][0])) {
+        info->killers[ply][1] = info->killers[ply][0];
+        info->killers[ply][0] = move;
+    }
+    int* entry = &info->history[side][SQUARE_OF(move.src_row, move.src_col)][SQUARE_OF(move.dst_row, move.dst_col)];
+    *entry += depth * depth;
+    if (*entry >= HISTORY_MAX) {
+        for (int from = 0; from < BOARD_SQUARES; from++)
+            for (int to = 0; to < BOARD_SQUARES; to++) {
+                info->history[SIDE_WHITE][from][to] /= 2;
+                info->history[SIDE_BLACK][from][to] /= 2;
+            }
+    }
+}
+
+/*
+ * update_pv:
+ * Records `move` followed by the child's PV as the line from this ply.
+ */
+void update_pv(SearchInfo* info, int ply, ChessMove move) {
+    info->pv[ply][0] = move;
+    int childLength = (ply + 1 < MAX_PLY) ? info->pvLength[ply + 1] : 0;
+    for (int i = 0; i < childLength && i + 1 < MAX_PLY; i++)
+        info->pv[ply][i + 1] = info->pv[ply + 1][i];
+    info->pvLength[ply] = (childLength + 1 < MAX_PLY) ? childLength + 1 : MAX_PLY;
+}
+
+/*
+ * evaluate:
+ * The static evaluation from the side to move's view, through the thread's evaluation
+ * cache and pawn hash.
+ */
+static int evaluate(const Position* pos, SearchInfo* info, int ply) {
+    PlyStats* stats = &info->stats.ply[ply];
+    EvalCache* cache = info->evalCache;
+    stats->evals++;
+    EvalCacheEntry* entry = &cache->evals[pos->key & (EVAL_CACHE_ENTRIES - 1)];
+    int score;
+    if (entry->key == pos->key) {
+        stats->evalCacheHits++;
+        score = entry->score;
+    }
+    else {
+        long long probes = cache->pawns.probes, hits = cache->pawns.hits;
+        score = evaluate_board(pos, &cache->pawns);
+        stats->pawnProbes += cache->pawns.probes - probes;
+        stats->pawnHits += cache->pawns.hits - hits;
+        entry->key = pos->key;
+        entry->score = score;
+    }
+    return (pos->sideToMove == SIDE_WHITE) ? score : -score;
+}
+
+/*
+ * quiescence:
+ * Resolves captures at the leaves so the static evaluation is only taken in quiet
+ * positions. The side to move may "stand pat" on the evaluation instead of capturing;
+ * captures that could not lift the score to alpha even when winning the victim
+ * outright (delta pruning) are skipped. In check every evasion is searched.
+ */
+#define DELTA_MARGIN 200
+
+int quiescence(Position* pos, SearchInfo* info, int ply, int alpha, int beta) {
+    info->pvLength[ply] = 0;
+    info->followPv = 0;
+    info->nodes++;
+    info->stats.ply[ply].qnodes++;
+    check_limits(info);
+    if (info->stopped) return 0;
+
+    int standPat = evaluate(pos, info, ply);
+    if (ply >= MAX_PLY - 1)
+        return standPat;
+
+    int inCheck = isKingInCheck(&pos->board, pos->sideToMove);
+    int bestScore = -INFINITE_SCORE;
+    if (!inCheck) {
+        if (standPat >= beta)
+            return standPat;
+        // Not even winning a queen would reach alpha.
+        if (standPat + pieceValues[QUEEN] + DELTA_MARGIN <= alpha)
+            return standPat;
+        if (standPat > alpha)
+            alpha = standPat;
+        bestScore = standPat;
+    }
+
+    ChessMove movesList[MAX_LEGAL_MOVES];
+    int numMoves = inCheck ? generateLegalMoves(pos, movesList) : generateCaptureMoves(pos, movesList);
+    if (inCheck && numMoves == 0)
+        return -MATE_SCORE + ply;
+    int scores[MAX_LEGAL_MOVES];
+    score_moves(pos, info, 0, ply, movesList, scores, numMoves);
+
+    for (int i = 0; i < numMoves; i++) {
+        pick_move(movesList, scores, numMoves, i);
+        ChessMove move = movesList[i];
+        if (!inCheck && !move.promoteTo) {
+            char victim = pos->board.squares[move.dst_row][move.dst_col];
+            int victimValue = pieceValues[(victim == EMPTY_CELL) ? PAWN : pieceTypeOf(victim)];
+            if (standPat + victimValue + DELTA_MARGIN <= alpha)
+                continue;
+        }
+        make_move(pos, move);
+        int score = -quiescence(pos, info, ply + 1, -beta, -alpha);
+        unmake_move(pos);
+        if (info->stopped) return 0;
+        if (score > bestScore)
+            bestScore = score;
+        if (bestScore > alpha)
+            alpha = bestScore;
+        if (alpha >= beta)
+            break;
+    }
+    return bestScore;
+}
+
+// Late move reductions by remaining depth and move number, filled by init_search_tables.
+int lmrReductions[MAX_PLY][MAX_LEGAL_MOVES];
+
+/*
+ * init_search_tables:
+ * Reductions grow with the logarithm of both the depth and the move number.
+ */
+void init_search_tables() {
+    for (int depth = 1; depth < MAX_PLY; depth++)
+        for (int moveNumber = 1; moveNumber < MAX_LEGAL_MOVES; moveNumber++)
+            lmrReductions[depth][moveNumber] = (int)(0.75 + log((double)depth) * log((double)moveNumber) / 2.25);
+}
+
+// Null-move pruning applies from this depth, and a fail high from this depth is
+// verified by a reduced search without null moves before it is trusted.
+#define NULL_MOVE_MIN_DEPTH 3
+#define NULL_MOVE_VERIFY_DEPTH 6
+
+/*
+ * minimax:
+ * A minimax search with alpha-beta pruning, in negamax form.
+ * It recursively evaluates positions to a specified depth and returns an evaluation score
+ * from the point of view of the side to move. The transposition table supplies cutoffs
+ * and the first move to try; `ply` is the distance from the root. Once the search is
+ * stopped the returned scores are meaningless and the caller discards them.
+ *
+ * On top of plain alpha-beta, each switchable with info->disabledFeatures:
+ *  - principal variation search: moves after the first get a zero window around alpha
+ *    and are searched again with the full window only if they beat it;
+ *  - null-move pruning: if passing still fails high on a reduced search, so will a real
+ *    move. Not used in check, at PV nodes, after another null move, or with only king
+ *    and pawns (where zugzwang is common), and deep fail highs are verified;
+ *  - late move reductions: quiet moves late in the ordering are searched shallower,
+ *    and again at full depth if they turn out to beat alpha;
+ *  - check extensions: a side in check is searched one ply deeper.
+ */
+int minimax(Position* pos, SearchInfo* info, int depth, int ply, int alpha, int beta) {
+    int originalAlpha = alpha;
+    int pvNode = beta - alpha > 1;
+    int onPv = info->followPv;
+    PlyStats* stats = &info->stats.ply[ply];
+    info->pvLength[ply] = 0;
+    info->nodes++;
+    stats->nodes++;
+    check_limits(info);
+    if (info->stopped) return 0;
+
+    // A repeated position, or one where the fifty-move rule can be claimed, is a draw;
+    // the cycle below it is not searched.
+    if (ply > 0 && (pos->halfmoveClock >= FIFTY_MOVE_PLIES || is_repetition(pos, 1))) {
+        stats->draws++;
+        return DRAW_SCORE;
+    }
+
+    TTData entry;
+    int ttHit = tt_probe(info->tt, pos->key, &entry);
+    stats->ttProbes++;
+    stats->ttHits += ttHit;
+    if (ttHit && entry.depth >= depth && ply > 0) {
+        int ttScore = score_from_tt(entry.score, ply);
+        if (entry.bound == BOUND_EXACT ||
+            (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+            (entry.bound == BOUND_UPPER && ttScore <= alpha)) {
+            stats->ttCutoffs++;
+            return ttScore;
+        }
+    }
+
+    // King and pawn against king is answered by the bitbase without searching.
+    int kpkScore;
+    if (ply > 0 && kpk_score(pos, &kpkScore))
+        return (pos->sideToMove == SIDE_WHITE) ? kpkScore : -kpkScore;
+
+    int inCheck = isKingInCheck(&pos->board, pos->sideToMove);
+    if (inCheck && !(info->disabledFeatures & FEATURE_CHECK_EXTENSION) && ply + depth < MAX_PLY - 1)
+        depth++;
+
+    if (depth <= 0 || ply >= MAX_PLY - 1)
+        return quiescence(pos, info, ply, alpha, beta);
+
+    const Bitboard* own = pos->board.pieces[pos->sideToMove];
+    int lastWasNull = pos->undoCount > 0 && is_null_move(pos->undoStack[pos->undoCount - 1].move);
+    if (!(info->disabledFeatures & FEATURE_NULL_MOVE) && !info->nullMoveDisabled && !pvNode && !inCheck &&
+        ply > 0 && depth >= NULL_MOVE_MIN_DEPTH && !lastWasNull && beta < MATE_BOUND &&
+        (own[KNIGHT] | own[BISHOP] | own[ROOK] | own[QUEEN])) {
+        int reduction = (depth > 6) ? 3 : 2;
+        stats->nullMoveTries++;
+        make_null_move(pos);
+        int score = -minimax(pos, info, depth - 1 - reduction, ply + 1, -beta, -beta + 1);
+        unmake_null_move(pos);
+        if (info->stopped) return 0;
+        if (score >= beta) {
+            if (score >= MATE_BOUND)
+                score = beta;
+            if (depth >= NULL_MOVE_VERIFY_DEPTH) {
+                info->nullMoveDisabled++;
+                int verified = minimax(pos, info, depth - reduction, ply, beta - 1, beta);
+                info->nullMoveDisabled--;
+                if (info->stopped) return 0;
+                if (verified < beta)
+                    score = -INFINITE_SCORE;
+            }
+            if (score >= beta) {
+                stats->nullMoveCutoffs++;
+                return score;
+            }
+        }
+    }
+
+    MovePicker picker;
+    init_move_picker(&picker, pos, info, ply, ttHit ? entry.move : 0);
+    stats->pickerNodes++;
+
+    int bestScore = -INFINITE_SCORE;
+    unsigned short bestMove = 0;
+    int movesSearched = 0;
+    ChessMove move;
+
+    while (next_move(&picker, &move)) {
+        int quiet = is_quiet(pos, move);
+        // Only the first child of a PV node can continue the previous PV.
+        info->followPv = onPv && movesSearched == 0 && ply < info->previousPvLength &&
+            same_move(move, info->previousPv[ply]);
+        movesSearched++;
+        stats->movesSearched++;
+        make_move(pos, move);
+        int score;
+        if (movesSearched == 1) {
+            score = -minimax(pos, info, depth - 1, ply + 1, -beta, -alpha);
+        }
+        else {
+            // Late quiet moves (not killers, not checks) are first searched shallower.
+            int reduction = 0;
+            if (!(info->disabledFeatures & FEATURE_LMR) && depth >= 3 && movesSearched > 3 && !inCheck &&
+                picker.stage == STAGE_QUIETS && !isKingInCheck(&pos->board, pos->sideToMove)) {
+                reduction = lmrReductions[depth][movesSearched < MAX_LEGAL_MOVES ? movesSearched : MAX_LEGAL_MOVES - 1];
+                if (pvNode && reduction > 0)
+                    reduction--;
+                if (reduction > depth - 2)
+                    reduction = depth - 2;
+                if (reduction > 0)
+                    stats->reductions++;
+            }
+            if (!(info->disabledFeatures & FEATURE_PVS)) {
+                score = -minimax(pos, info, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+                if (score > alpha && reduction) {
+                    stats->researches++;
+                    score = -minimax(pos, info, depth - 1, ply + 1, -alpha - 1, -alpha);
+                }
+                if (score > alpha && score < beta)
+                    score = -minimax(pos, info, depth - 1, ply + 1, -beta, -alpha);
+            }
+            else {
+                score = -minimax(pos, info, depth - 1 - reduction, ply + 1, -beta, -alpha);
+                if (score > alpha && reduction) {
+                    stats->researches++;
+                    score = -minimax(pos, info, depth - 1, ply + 1, -beta, -alpha);
+                }
+            }
+        }
+        unmake_move(pos);
+        if (info->stopped) return 0;
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = pack_move(move);
+        }
+        if (bestScore > alpha) {
+            alpha = bestScore;
+            update_pv(info, ply, move);
+        }
+        if (alpha >= beta) {
+            stats->betaCutoffs++;
+            if (movesSearched == 1)
+                stats->firstMoveCutoffs++;
+            if (quiet)
+                update_quiet_stats(info, pos->sideToMove, ply, depth, move);
+            break;
+        }
+    }
+    info->followPv = 0;
+    if (movesSearched == 0) {
+        // No moves: checkmate if king is in check, stalemate otherwise.
+        if (inCheck)
+            return -MATE_SCORE + ply;
+        else
+            return DRAW_SCORE;
+    }
+
+    int bound = (bestScore <= originalAlpha) ? BOUND_UPPER : (bestScore >= beta) ? BOUND_LOWER : BOUND_EXACT;
+    tt_store(info->tt, pos->key, depth, bound, score_to_tt(bestScore, ply), bestMove);
+    return bestScore;
+}
+
+/*
+ * reset_search:
+ * Clears one thread's per-search counters and results before a new search.
+ */
+static void reset_search(SearchInfo* info) {
+    info->nodes = 0;
+    info->stopped = 0;
+    info->completedDepth = 0;
+    info->previousPvLength = 0;
+    info->bestScore = 0;
+    info->nullMoveDisabled = 0;
+    memset(&info->stats, 0, sizeof(info->stats));
+    memset(info->killers, 0, sizeof(info->killers));
+    // History carries over from the previous search at reduced weight.
+    for (int from = 0; from < BOARD_SQUARES; from++)
+        for (int to = 0; to < BOARD_SQUARES; to++) {
+            info->history[SIDE_WHITE][from][to] /= 8;
+            info->history[SIDE_BLACK][from][to] /= 8;
+        }
+}
+
+/*
+ * format_move_uci:
+ * Writes a move in UCI long algebraic notation ("e2e4", "e7e8q") into out, which must
+ * hold at least 6 characters.
+ */
+void format_move_uci(ChessMove move, char* out) {
+    out[0] = 'a' + move.src_col;
+    out[1] = '8' - move.src_row;
+    out[2] = 'a' + move.dst_col;
+    out[3] = '8' - move.dst_row;
+    out[4] = move.promoteTo ? (char)tolower(move.promoteTo) : 0;
+    out[5] = 0;
+}
+
+/*
+ * uci_send:
+ * Prints one line to the GUI and flushes it. The search thread and the command loop
+ * both send, so each line is written whole under a lock.
+ */
+void uci_send(const char* format, ...) {
+    static std::mutex outputLock;
+    char line[4096];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    std::lock_guard<std::mutex> guard(outputLock);
+    fputs(line, stdout);
+    fputc('\n', stdout);
+    fflush(stdout);
+}
+
+/*
+ * send_uci_info:
+ * Reports a completed iteration: depth, score (in centipawns or moves to mate), nodes of
+ * all threads, time, nps and the principal variation.
+ */
+static void send_uci_info(SearchInfo* info, int depth, int score) {
+    char line[3072];
+    long long elapsed = now_ms() - info->startTime;
+    long long nodes = info->nodes + info->helperNodes.load(std::memory_order_relaxed);
+    int length = snprintf(line, sizeof(line), "info depth %d score ", depth);
+    if (score >= MATE_BOUND)
+        length += snprintf(line + length, sizeof(line) - length, "mate %d", (MATE_SCORE - score + 1) / 2);
+    else if (score <= -MATE_BOUND)
+        length += snprintf(line + length, sizeof(line) - length, "mate %d", -(MATE_SCORE + score) / 2);
+    else
+        length += snprintf(line + length, sizeof(line) - length, "cp %d", score);
+    length += snprintf(line + length, sizeof(line) - length, " nodes %lld nps %lld time %lld pv",
+        nodes, elapsed ? nodes * 1000 / elapsed : nodes * 1000, elapsed);
+    for (int i = 0; i < info->pvLength[0]; i++) {
+        char move[6];
+        format_move_uci(info->pv[0][i], move);
+        length += snprintf(line + length, sizeof(line) - length, " %s", move);
+    }
+    uci_send("%s", line);
+}
+
+/*
+ * iterative_deepening:
+ * One thread's deepening loop. Every odd-numbered helper starts a ply deeper than the
+ * main thread, so helpers spread over neighbouring depths instead of all repeating it.
+ */
+static void iterative_deepening(Position* pos, SearchInfo* info) {
+    int maxDepth = (info->limits.maxDepth > 0 && info->limits.maxDepth < MAX_PLY) ? info->limits.maxDepth : MAX_PLY - 1;
+    for (int depth = 1 + (info->threadId & 1); depth <= maxDepth; depth++) {
+        info->followPv = 1;
+        int score = minimax(pos, info, depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+        if (info->stopped)
+            break;
+
+        info->completedDepth = depth;
+        info->bestScore = score;
+        info->stats.iterationNodes[depth] = info->nodes;
+        if (info->pvLength[0] > 0)
+            info->bestMove = info->pv[0][0];
+        info->previousPvLength = info->pvLength[0];
+        memcpy(info->previousPv, info->pv[0], info->pvLength[0] * sizeof(ChessMove));
+        if (info->uciOutput && !info->mainThread)
+            send_uci_info(info, depth, score);
+
+        // A mate found within the full-width depth will not improve (one seen only through
+        // the hash table may be stale), and a new iteration that cannot finish in the
+        // remaining time would only be thrown away.
+        if ((score >= MATE_BOUND || score <= -MATE_BOUND) && MATE_SCORE - abs(score) <= depth)
+            break;
+        if (!info->mainThread && info->limits.moveTimeMs && !info->pondering.load() &&
+            now_ms() - info->limitsStart.load() >= info->limits.moveTimeMs / 2)
+            break;
+    }
+}
+
+/*
+ * choose_best_move:
+ * Searches the position with iterative deepening until the limits in info->limits are
+ * reached, and returns the best move of the last depth that completed. Each iteration
+ * searches the previous principal variation first. info->bestScore and
+ * info->completedDepth describe the returned move, and info->nodes counts every thread.
+ * The search also ends early once info->stopRequested is set, which another thread may
+ * do at any time; the caller clears it before starting. A caller that sets
+ * info->pondering first gets a ponder search, which ignores the time and node limits
+ * until ponder_hit.
+ *
+ * With info->threads > 1 this is a Lazy SMP search: helper threads search their own copy
+ * of the root at staggered depths and share results only through the transposition
+ * table. The deepest completed result of any thread is played.
+ */
+ChessMove choose_best_move(Position* pos, SearchInfo* info) {
+    info->startTime = now_ms();
+    info->limitsStart.store(info->startTime);
+    info->threadId = 0;
+    info->mainThread = NULL;
+    info->searchDone.store(0);
+    info->helperNodes.store(0);
+    reset_search(info);
+    tt_new_search(info->tt);
+    if (!info->evalCache)
+        info->evalCache = eval_cache_new();
+
+    ChessMove movesList[MAX_LEGAL_MOVES];
+    int numMoves = generateLegalMoves(pos, movesList);
+    if (numMoves == 0) {
+        memset(&info->bestMove, 0, sizeof(info->bestMove));
+        return info->bestMove;
+    }
+    info->bestMove = movesList[0];
+
+    int helperCount = (info->threads > MAX_THREADS ? MAX_THREADS : info->threads) - 1;
+    SearchInfo* helpers[MAX_THREADS];
+    Position* helperPositions[MAX_THREADS];
+    std::thread helperThreads[MAX_THREADS];
+    for (int i = 0; i < helperCount; i++) {
+        helpers[i] = new SearchInfo();
+        helpers[i]->limits = info->limits;
+        helpers[i]->disabledFeatures = info->disabledFeatures;
+        helpers[i]->tt = info->tt;
+        helpers[i]->threadId = i + 1;
+        helpers[i]->mainThread = info;
+        helpers[i]->startTime = info->startTime;
+        helpers[i]->bestMove = movesList[0];
+        helpers[i]->evalCache = eval_cache_new();
+        helperPositions[i] = new Position(*pos);
+        helperThreads[i] = std::thread(iterative_deepening, helperPositions[i], helpers[i]);
+    }
+
+    iterative_deepening(pos, info);
+
+    info->searchDone.store(1);
+    for (int i = 0; i < helperCount; i++) {
+        helperThreads[i].join();
+        SearchInfo* helper = helpers[i];
+        info->nodes += helper->nodes;
+        stats_add(&info->stats, &helper->stats, 0);
+        if (helper->completedDepth > info->completedDepth) {
+            info->completedDepth = helper->completedDepth;
+            info->bestScore = helper->bestScore;
+            info->bestMove = helper->bestMove;
+        }
+        delete helperPositions[i];
+        free(helper->evalCache);
+        delete helper;
+    }
+    return info->bestMove;
+}
+
+/*
+ * ponder_move:
+ * The reply expected from the opponent after the move the search chose: the next move of
+ * the principal variation, or else the hash move of the position after it. Returns 0 if
+ * there is none.
+ */
+int ponder_move(const Position* pos, SearchInfo* info, ChessMove* reply) {
+    if (is_null_move(info->bestMove))
+        return 0;
+    if (info->previousPvLength >= 2 && same_move(info->previousPv[0], info->bestMove)) {
+        *reply = info->previousPv[1];
+        return 1;
+    }
+    Position* next = new Position(*pos);
+    make_move(next, info->bestMove);
+    TTData entry;
+    int found = tt_probe(info->tt, next->key, &entry) && entry.move &&
+        move_is_legal(next, unpack_move(entry.move));
+    if (found)
+        *reply = unpack_move(entry.move);
+    delete next;
+    return found;
+}
+
+/*
+ * ponder_hit:
+ * The opponent played the expected move, so the ponder search becomes the real one: it
+ * keeps everything searched so far, and its time budget starts now.
+ */
+void ponder_hit(SearchInfo* info) {
+    info->limitsStart.store(now_ms());
+    info->pondering.store(0);
+}
+
+/*
+ * format_search_stats:
+ * One-line summary of a search's counters: node mix, evaluations, effective branching
+ * factor, cutoff and hash rates, moves generated and searched per node, and how often
+ * null moves and reductions paid off.
+ */
+void format_search_stats(char* out, size_t size, const SearchStats* stats, long long elapsedMs) {
+    PlyStats total = stats_total(stats);
+    long long allNodes = total.nodes + total.qnodes;
+    snprintf(out, size,
+        "nodes %lld (%.0f%% quiescence), nps %lld, evals %lld, ebf %.2f, first-move cutoffs %.1f%%, "
+        "hash hits %.1f%%, eval cache hits %.1f%%, pawn hash hits %.1f%%, moves generated %.1f / "
+        "searched %.1f per node, null-move cutoffs %.1f%%, reductions re-searched %.1f%%",
+        allNodes, allNodes ? 100.0 * total.qnodes / allNodes : 0.0,
+        elapsedMs ? allNodes * 1000 / elapsedMs : allNodes * 1000, total.evals,
+        effective_branching_factor(stats),
+        total.betaCutoffs ? 100.0 * total.firstMoveCutoffs / total.betaCutoffs : 0.0,
+        total.ttProbes ? 100.0 * total.ttHits / total.ttProbes : 0.0,
+        total.evals ? 100.0 * total.evalCacheHits / total.evals : 0.0,
+        total.pawnProbes ? 100.0 * total.pawnHits / total.pawnProbes : 0.0,
+        total.pickerNodes ? (double)total.movesGenerated / total.pickerNodes : 0.0,
+        total.pickerNodes ? (double)total.movesSearched / total.pickerNodes : 0.0,
+        total.nullMoveTries ? 100.0 * total.nullMoveCutoffs / total.nullMoveTries : 0.0,
+        total.reductions ? 100.0 * total.researches / total.reductions : 0.0);
+}
+
+/*
+ * write_search_stats_json:
+ * Writes a search's counters as one JSON object on one line: the totals, the derived
+ * rates, the nodes at the end of each iteration and every ply that was reached.
+ */
+void write_search_stats_json(FILE* file, const SearchStats* stats, int depth, int score, long long elapsedMs) {
+    PlyStats total = stats_total(stats);
+    fprintf(file, "{\"depth\":%d,\"score\":%d,\"time_ms\":%lld", depth, score, elapsedMs);
+    for (int field = 0; field < PLY_STAT_FIELDS; field++)
+        fprintf(file, ",\"%s\":%lld", plyStatFields[field].name, *ply_stat(&total, field));
+    fprintf(file, ",\"ebf\":%.3f,\"first_move_cutoff_rate\":%.4f,\"tt_hit_rate\":%.4f,\"eval_cache_hit_rate\":%.4f,"
+        "\"pawn_hit_rate\":%.4f,\"iteration_nodes\":[",
+        effective_branching_factor(stats),
+        total.betaCutoffs ? (double)total.firstMoveCutoffs / total.betaCutoffs : 0.0,
+        total.ttProbes ? (double)total.ttHits / total.ttProbes : 0.0,
+        total.evals ? (double)total.evalCacheHits / total.evals : 0.0,
+        total.pawnProbes ? (double)total.pawnHits / total.pawnProbes : 0.0);
+    for (int d = 1; d <= depth && d < MAX_PLY; d++)
+        fprintf(file, "%s%lld", d > 1 ? "," : "", stats->iterationNodes[d]);
+    fprintf(file, "],\"plies\":[");
+    int first = 1;
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        PlyStats* plyStats = (PlyStats*)&stats->ply[ply];
+        if (!plyStats->nodes && !plyStats->qnodes)
+            continue;
+        fprintf(file, "%s{\"ply\":%d", first ? "" : ",", ply);
+        for (int field = 0; field < PLY_STAT_FIELDS; field++)
+            fprintf(file, ",\"%s\":%lld", plyStatFields[field].name, *ply_stat(plyStats, field));
+        fprintf(file, "}");
+        first = 0;
+    }
+    fprintf(file, "]}\n");
+    fflush(file);
+}
+
+// Where write_search_stats_json output goes after each search (--stats-json), if anywhere.
+FILE* statsJsonFile;
+
+// Polyglot opening book: a sorted array of 16-byte big-endian entries (key, move, weight,
+// learn) mapped read-only into memory, so opening it costs nothing and its pages are
+// shared with any other process using the same file.
+#define POLYGLOT_ENTRY_SIZE 16
+#define POLYGLOT_RANDOM_COUNT 781
+
+typedef struct {
+    const unsigned char* entries;
+    size_t count;
+    size_t mappedSize;
+    int pickBest;           // Play the highest-weight move instead of a weighted random choice.
+} OpeningBook;
+
+OpeningBook openingBook;
+
+// The 781 "Random64" constants of the Polyglot book format, in the order of its
+// specification: 768 for the pieces, 4 for the castling rights, 8 for the en passant
+// file and 1 for White to move. The Polyglot key of a position is built from them.
+static const HashKey polyglotRandom[POLYGLOT_RANDOM_COUNT] = {
+    0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+    0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+    0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+    0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+    0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+    0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+    0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+    0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+    0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+    0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+    0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+    0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+    0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+    0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+    0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+    0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+    0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+    0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+    0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+    0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+    0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+    0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+    0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+    0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+    0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+    0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+    0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+    0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+    0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+    0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+    0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+    0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+    0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+    0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+    0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+    0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+    0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+    0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+    0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+    0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+    0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+    0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+    0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+    0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+    0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+    0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+    0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+    0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+    0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+    0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+    0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+    0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+    0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+    0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+    0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+    0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+    0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+    0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+    0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+    0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+    0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+    0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+    0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+    0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+    0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+    0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+    0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+    0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+    0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+    0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+    0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+    0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+    0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+    0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+    0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+    0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+    0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+    0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+    0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+    0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+    0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+    0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+    0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+    0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+    0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+    0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+    0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+    0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+    0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+    0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+    0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+    0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+    0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+    0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+    0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+    0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+    0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+    0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+    0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+    0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+    0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+    0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+    0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+    0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+    0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+    0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+    0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+    0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+    0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+    0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+    0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+    0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+    0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+    0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+    0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+    0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+    0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+    0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+    0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+    0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+    0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+    0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+    0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+    0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+    0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+    0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+    0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+    0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+    0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+    0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+    0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+    0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+    0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+    0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+    0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+    0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+    0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+    0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+    0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+    0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x1B6BACA2AE4E125BULL, 0x758F450C88572E0BULL,
+    0x959F587D507A8359ULL, 0xB063E962E045F54DULL, 0x60E8ED72C0DFF5D1ULL, 0x7B64978555326F9FULL,
+    0xFD080D236DA814BAULL, 0x8C90FD9B083F4558ULL, 0x106F72FE81E2C590ULL, 0x7976033A39F7D952ULL,
+    0xA4EC0132764CA04BULL, 0x733EA705FAE4FA77ULL, 0xB4D8F77BC3E56167ULL, 0x9E21F4F903B33FD9ULL,
+    0x9D765E419FB69F6DULL, 0xD30C088BA61EA5EFULL, 0x5D94337FBFAF7F5BULL, 0x1A4E4822EB4D7A59ULL,
+    0x6FFE73E81B637FB3ULL, 0xDDF957BC36D8B9CAULL, 0x64D0E29EEA8838B3ULL, 0x08DD9BDFD96B9F63ULL,
+    0x087E79E5A57D1D13ULL, 0xE328E230E3E2B3FBULL, 0x1C2559E30F0946BEULL, 0x720BF5F26F4D2EAAULL,
+    0xB0774D261CC609DBULL, 0x443F64EC5A371195ULL, 0x4112CF68649A260EULL, 0xD813F2FAB7F5C5CAULL,
+    0x660D3257380841EEULL, 0x59AC2C7873F910A3ULL, 0xE846963877671A17ULL, 0x93B633ABFA3469F8ULL,
+    0xC0C0F5A60EF4CDCFULL, 0xCAF21ECD4377B28CULL, 0x57277707199B8175ULL, 0x506C11B9D90E8B1DULL,
+    0xD83CC2687A19255FULL, 0x4A29C6465A314CD1ULL, 0xED2DF21216235097ULL, 0xB5635C95FF7296E2ULL,
+    0x22AF003AB672E811ULL, 0x52E762596BF68235ULL, 0x9AEBA33AC6ECC6B0ULL, 0x944F6DE09134DFB6ULL,
+    0x6C47BEC883A7DE39ULL, 0x6AD047C430A12104ULL, 0xA5B1CFDBA0AB4067ULL, 0x7C45D833AFF07862ULL,
+    0x5092EF950A16DA0BULL, 0x9338E69C052B8E7BULL, 0x455A4B4CFE30E3F5ULL, 0x6B02E63195AD0CF8ULL,
+    0x6B17B224BAD6BF27ULL, 0xD1E0CCD25BB9C169ULL, 0xDE0C89A556B9AE70ULL, 0x50065E535A213CF6ULL,
+    0x9C1169FA2777B874ULL, 0x78EDEFD694AF1EEDULL, 0x6DC93D9526A50E68ULL, 0xEE97F453F06791EDULL,
+    0x32AB0EDB696703D3ULL, 0x3A6853C7E70757A7ULL, 0x31865CED6120F37DULL, 0x67FEF95D92607890ULL,
+    0x1F2B1D1F15F6DC9CULL, 0xB69E38A8965C6B65ULL, 0xAA9119FF184CCCF4ULL, 0xF43C732873F24C13ULL,
+    0xFB4A3D794A9A80D2ULL, 0x3550C2321FD6109CULL, 0x371F77E76BB8417EULL, 0x6BFA9AAE5EC05779ULL,
+    0xCD04F3FF001A4778ULL, 0xE3273522064480CAULL, 0x9F91508BFFCFC14AULL, 0x049A7F41061A9E60ULL,
+    0xFCB6BE43A9F2FE9BULL, 0x08DE8A1C7797DA9BULL, 0x8F9887E6078735A1ULL, 0xB5B4071DBFC73A66ULL,
+    0x230E343DFBA08D33ULL, 0x43ED7F5A0FAE657DULL, 0x3A88A0FBBCB05C63ULL, 0x21874B8B4D2DBC4FULL,
+    0x1BDEA12E35F6A8C9ULL, 0x53C065C6C8E63528ULL, 0xE34A1D250E7A8D6BULL, 0xD6B04D3B7651DD7EULL,
+    0x5E90277E7CB39E2DULL, 0x2C046F22062DC67DULL, 0xB10BB459132D0A26ULL, 0x3FA9DDFB67E2F199ULL,
+    0x0E09B88E1914F7AFULL, 0x10E8B35AF3EEAB37ULL, 0x9EEDECA8E272B933ULL, 0xD4C718BC4AE8AE5FULL,
+    0x81536D601170FC20ULL, 0x91B534F885818A06ULL, 0xEC8177F83F900978ULL, 0x190E714FADA5156EULL,
+    0xB592BF39B0364963ULL, 0x89C350C893AE7DC1ULL, 0xAC042E70F8B383F2ULL, 0xB49B52E587A1EE60ULL,
+    0xFB152FE3FF26DA89ULL, 0x3E666E6F69AE2C15ULL, 0x3B544EBE544C19F9ULL, 0xE805A1E290CF2456ULL,
+    0x24B33C9D7ED25117ULL, 0xE74733427B72F0C1ULL, 0x0A804D18B7097475ULL, 0x57E3306D881EDB4FULL,
+    0x4AE7D6A36EB5DBCBULL, 0x2D8D5432157064C8ULL, 0xD1E649DE1E7F268BULL, 0x8A328A1CEDFE552CULL,
+    0x07A3AEC79624C7DAULL, 0x84547DDC3E203C94ULL, 0x990A98FD5071D263ULL, 0x1A4FF12616EEFC89ULL,
+    0xF6F7FD1431714200ULL, 0x30C05B1BA332F41CULL, 0x8D2636B81555A786ULL, 0x46C9FEB55D120902ULL,
+    0xCCEC0A73B49C9921ULL, 0x4E9D2827355FC492ULL, 0x19EBB029435DCB0FULL, 0x4659D2B743848A2CULL,
+    0x963EF2C96B33BE31ULL, 0x74F85198B05A2E7DULL, 0x5A0F544DD2B1FB18ULL, 0x03727073C2E134B1ULL,
+    0xC7F6AA2DE59AEA61ULL, 0x352787BAA0D7C22FULL, 0x9853EAB63B5E0B35ULL, 0xABBDCDD7ED5C0860ULL,
+    0xCF05DAF5AC8D77B0ULL, 0x49CAD48CEBF4A71EULL, 0x7A4C10EC2158C4A6ULL, 0xD9E92AA246BF719EULL,
+    0x13AE978D09FE5557ULL, 0x730499AF921549FFULL, 0x4E4B705B92903BA4ULL, 0xFF577222C14F0A3AULL,
+    0x55B6344CF97AAFAEULL, 0xB862225B055B6960ULL, 0xCAC09AFBDDD2CDB4ULL, 0xDAF8E9829FE96B5FULL,
+    0xB5FDFC5D3132C498ULL, 0x310CB380DB6F7503ULL, 0xE87FBB46217A360EULL, 0x2102AE466EBB1148ULL,
+    0xF8549E1A3AA5E00DULL, 0x07A69AFDCC42261AULL, 0xC4C118BFE78FEAAEULL, 0xF9F4892ED96BD438ULL,
+    0x1AF3DBE25D8F45DAULL, 0xF5B4B0B0D2DEEEB4ULL, 0x962ACEEFA82E1C84ULL, 0x046E3ECAAF453CE9ULL,
+    0xF05D129681949A4CULL, 0x964781CE734B3C84ULL, 0x9C2ED44081CE5FBDULL, 0x522E23F3925E319EULL,
+    0x177E00F9FC32F791ULL, 0x2BC60A63A6F3B3F2ULL, 0x222BBFAE61725606ULL, 0x486289DDCC3D6780ULL,
+    0x7DC7785B8EFDFC80ULL, 0x8AF38731C02BA980ULL, 0x1FAB64EA29A2DDF7ULL, 0xE4D9429322CD065AULL,
+    0x9DA058C67844F20CULL, 0x24C0E332B70019B0ULL, 0x233003B5A6CFE6ADULL, 0xD586BD01C5C217F6ULL,
+    0x5E5637885F29BC2BULL, 0x7EBA726D8C94094BULL, 0x0A56A5F0BFE39272ULL, 0xD79476A84EE20D06ULL,
+    0x9E4C1269BAA4BF37ULL, 0x17EFEE45B0DEE640ULL, 0x1D95B0A5FCF90BC6ULL, 0x93CBE0B699C2585DULL,
+    0x65FA4F227A2B6D79ULL, 0xD5F9E858292504D5ULL, 0xC2B5A03F71471A6FULL, 0x59300222B4561E00ULL,
+    0xCE2F8642CA0712DCULL, 0x7CA9723FBB2E8988ULL, 0x2785338347F2BA08ULL, 0xC61BB3A141E50E8CULL,
+    0x150F361DAB9DEC26ULL, 0x9F6A419D382595F4ULL, 0x64A53DC924FE7AC9ULL, 0x142DE49FFF7A7C3DULL,
+    0x0C335248857FA9E7ULL, 0x0A9C32D5EAE45305ULL, 0xE6C42178C4BBB92EULL, 0x71F1CE2490D20B07ULL,
+    0xF1BCC3D275AFE51AULL, 0xE728E8C83C334074ULL, 0x96FBF83A12884624ULL, 0x81A1549FD6573DA5ULL,
+    0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+    0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A0ULL, 0x1EF6E6DBB1961EC9ULL,
+    0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+    0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+    0xF8D626AAAF278509ULL
+};
+
+/*
+ * book_open:
+ * Maps a Polyglot .bin file read-only. Returns 0 if it cannot be opened or is not a
+ * whole number of entries.
+ */
+int book_open(OpeningBook* book, const char* path) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = size.QuadPart ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(file);
+    if (!mapping) return 0;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return 0;
+    size_t fileSize = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat info;
+    if (fstat(fd, &info) || info.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return 0;
+    size_t fileSize = (size_t)info.st_size;
+#endif
+    if (fileSize % POLYGLOT_ENTRY_SIZE) {
+#if defined(_WIN32)
+        UnmapViewOfFile(view);
+#else
+        munmap(view, fileSize);
+#endif
+        return 0;
+    }
+    book->entries = (const unsigned char*)view;
+    book->count = fileSize / POLYGLOT_ENTRY_SIZE;
+    book->mappedSize = fileSize;
+    return 1;
+}
+
+static inline unsigned long long read_big_endian(const unsigned char* bytes, int length) {
+    unsigned long long value = 0;
+    for (int i = 0; i < length; i++)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+/*
+ * polyglot_key:
+ * Computes the Polyglot key of a position: pieces, castling rights, the en passant file
+ * (only when a pawn of the side to move can actually capture there) and White to move.
+ */
+HashKey polyglot_key(const Position* pos) {
+    HashKey key = 0;
+    for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+        for (int type = PAWN; type <= KING; type++) {
+            Bitboard pieces = pos->board.pieces[side][type];
+            while (pieces) {
+                int square = pop_lsb(&pieces);
+                int kind = type * 2 + (side == SIDE_WHITE ? 1 : 0);
+                key ^= polyglotRandom[64 * kind + 8 * (7 - ROW_OF(square)) + COL_OF(square)];
+            }
+        }
+    static const int castleFlags[4] = { CASTLE_WHITE_KING, CASTLE_WHITE_QUEEN, CASTLE_BLACK_KING, CASTLE_BLACK_QUEEN };
+    for (int i = 0; i < 4; i++)
+        if (pos->castlingRights & castleFlags[i])
+            key ^= polyglotRandom[768 + i];
+    if (pos->enPassantSquare != -1) {
+        int opponent = (pos->sideToMove == SIDE_WHITE) ? SIDE_BLACK : SIDE_WHITE;
+        if (pawnAttacks[opponent][pos->enPassantSquare] & pos->board.pieces[pos->sideToMove][PAWN])
+            key ^= polyglotRandom[772 + COL_OF(pos->enPassantSquare)];
+    }
+    if (pos->sideToMove == SIDE_WHITE)
+        key ^= polyglotRandom[780];
+    return key;
+}
+
+/*
+ * book_move:
+ * Looks the position up in the book by binary search and picks one of its moves, either
+ * the highest-weight one or at random in proportion to the weights. Only moves that are
+ * legal here are considered. Returns 1 and sets *move on a hit.
+ */
+int book_move(const OpeningBook* book, const Position* pos, ChessMove* move) {
+    if (!book->entries)
+        return 0;
+    HashKey key = polyglot_key(pos);
+    size_t low = 0, high = book->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (read_big_endian(book->entries + middle * POLYGLOT_ENTRY_SIZE, 8) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    ChessMove legalMoves[MAX_LEGAL_MOVES];
+    int numLegal = generateLegalMoves(pos, legalMoves);
+    ChessMove candidates[MAX_LEGAL_MOVES];
+    int weights[MAX_LEGAL_MOVES];
+    int numCandidates = 0, totalWeight = 0;
+    for (size_t i = low; i < book->count && numCandidates < MAX_LEGAL_MOVES; i++) {
+        const unsigned char* entry = book->entries + i * POLYGLOT_ENTRY_SIZE;
+        if (read_big_endian(entry, 8) != key)
+            break;
+        int packed = (int)read_big_endian(entry + 8, 2);
+        int weight = (int)read_big_endian(entry + 10, 2);
+        ChessMove candidate;
+        candidate.dst_col = packed & 7;
+        candidate.dst_row = 7 - ((packed >> 3) & 7);
+        candidate.src_col = (packed >> 6) & 7;
+        candidate.src_row = 7 - ((packed >> 9) & 7);
+        candidate.promoteTo = 0;
+        int promotion = (packed >> 12) & 7;
+        if (promotion) {
+            char symbol = " nbrq"[promotion > 4 ? 0 : promotion];
+            candidate.promoteTo = (pos->sideToMove == SIDE_WHITE) ? (char)toupper(symbol) : symbol;
+        }
+        // Polyglot writes castling as the king taking its own rook.
+        char piece = pos->board.squares[candidate.src_row][candidate.src_col];
+        if (tolower(piece) == 'k' && candidate.src_col == 4 && candidate.dst_row == candidate.src_row) {
+            if (candidate.dst_col == 7) candidate.dst_col = 6;
+            else if (candidate.dst_col == 0) candidate.dst_col = 2;
+        }
+        for (int j = 0; j < numLegal; j++) {
+            if (same_move(legalMoves[j], candidate)) {
+                candidates[numCandidates] = candidate;
+                weights[numCandidates++] = weight;
+                totalWeight += weight;
+                break;
+            }
+        }
+    }
+    if (numCandidates == 0)
+        return 0;
+
+    int chosen = 0;
+    if (book->pickBest || totalWeight == 0) {
+        for (int i = 1; i < numCandidates; i++)
+            if (weights[i] > weights[chosen])
+                chosen = i;
+    }
+    else {
+        int pick = (int)(((long long)rand() * RAND_MAX + rand()) % totalWeight);
+        while (pick >= weights[chosen])
+            pick -= weights[chosen++];
+    }
+    *move = candidates[chosen];
+    return 1;
+}
+
+/*
+ * play_move_string:
+ * Plays a move given in coordinate notation if it is legal in the position. Returns 1 on success,
+ * 0 also when the undo stack has no room left for a search below the position.
+ */
+int play_move_string(Position* pos, char* text) {
+    ChessMove move;
+    ChessMove legalMoves[MAX_LEGAL_MOVES];
+    if (!interpret_move(pos, text, &move) || pos->undoCount >= MAX_UNDO - MAX_PLY)
+        return 0;
+    int numLegal = generateLegalMoves(pos, legalMoves);
+    for (int i = 0; i < numLegal; i++) {
+        if (same_move(legalMoves[i], move)) {
+            make_game_move(pos, move);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Perft hash: leaf counts of subtrees already walked, keyed by position and depth. Each
+// entry is stored like a transposition table entry, as (key ^ data, data), so threads
+// can share it without locks and a torn write simply reads as a miss.
+typedef struct {
+    std::atomic<unsigned long long> check;
+    std::atomic<unsigned long long> data;  // Leaf count in the upper 56 bits, depth in the low 8.
+} PerftEntry;
+
+typedef struct {
+    PerftEntry* entries;
+    size_t mask;
+} PerftTable;
+
+PerftTable perftTable;
+
+/*
+ * perft_hash_resize:
+ * Allocates a perft hash of about sizeMB megabytes (rounded down to a power of two entries).
+ * A size of zero turns the hash off.
+ */
+int perft_hash_resize(PerftTable* table, size_t sizeMB) {
+    free(table->entries);
+    table->entries = NULL;
+    table->mask = 0;
+    if (!sizeMB)
+        return 1;
+    size_t count = 1;
+    while (count * 2 * sizeof(PerftEntry) <= sizeMB * 1024 * 1024)
+        count *= 2;
+    table->entries = (PerftEntry*)calloc(count, sizeof(PerftEntry));
+    if (!table->entries)
+        return 0;
+    table->mask = count - 1;
+    return 1;
+}
+
+/*
+ * perft:
+ * Counts the leaf nodes of the legal move tree to the given depth. The last ply is
+ * bulk-counted from the move list instead of being played.
+ */
+unsigned long long perft(Position* pos, int depth, PerftTable* table) {
+    ChessMove movesList[MAX_LEGAL_MOVES];
+    int numMoves = generateLegalMoves(pos, movesList);
+    if (depth <= 1)
+        return depth == 1 ? (unsigned long long)numMoves : 1;
+
+    PerftEntry* entry = table->entries ? &table->entries[pos->key & table->mask] : NULL;
+    if (entry) {
+        unsigned long long data = entry->data.load(std::memory_order_relaxed);
+        unsigned long long check = entry->check.load(std::memory_order_relaxed);
+        if ((check ^ data) == pos->key && (int)(data & 0xFF) == depth)
+            return data >> 8;
+    }
+
+    unsigned long long nodes = 0;
+    for (int i = 0; i < numMoves; i++) {
+        make_move(pos, movesList[i]);
+        nodes += perft(pos, depth - 1, table);
+        unmake_move(pos);
+    }
+
+    if (entry) {
+        unsigned long long data = (nodes << 8) | (unsigned long long)depth;
+        entry->data.store(data, std::memory_order_relaxed);
+        entry->check.store(pos->key ^ data, std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+// A piece of perft work: the subtree below one root move, or below one reply to it
+// when the tree is deep enough to be worth splitting further.
+typedef struct {
+    int rootIndex;
+    ChessMove moves[2];
+    int numMoves;
+} PerftTask;
+
+// Each worker owns a queue; it takes work from the back of its own and, once that is
+// empty, steals from the front of the others.
+typedef struct {
+    std::mutex lock;
+    std::deque<PerftTask> tasks;
+} PerftQueue;
+
+typedef struct {
+    const Position* root;
+    int depth;
+    int threads;
+    PerftQueue* queues;
+    std::atomic<unsigned long long>* rootCounts;
+} PerftJob;
+
+static int perft_next_task(PerftJob* job, int workerId, PerftTask* task) {
+    for (int i = 0; i < job->threads; i++) {
+        PerftQueue* queue = &job->queues[(workerId + i) % job->threads];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if (queue->tasks.empty())
+            continue;
+        if (i == 0) {
+            *task = queue->tasks.back();
+            queue->tasks.pop_back();
+        }
+        else {
+            *task = queue->tasks.front();
+            queue->tasks.pop_front();
+        }
+        return 1;
+    }
+    return 0;
+}
+
+static void perft_worker(PerftJob* job, int workerId) {
+    Position* pos = new Position(*job->root);
+    PerftTask task;
+    while (perft_next_task(job, workerId, &task)) {
+        for (int i = 0; i < task.numMoves; i++)
+            make_move(pos, task.moves[i]);
+        unsigned long long nodes = perft(pos, job->depth - task.numMoves, &perftTable);
+        for (int i = 0; i < task.numMoves; i++)
+            unmake_move(pos);
+        job->rootCounts[task.rootIndex] += nodes;
+    }
+    delete pos;
+}
+
+/*
+ * run_perft:
+ * Counts the move tree below the position on `threads` threads and prints the count
+ * below each root move ("divide"), the total and nodes/sec.
+ */
+void run_perft(const Position* root, int depth, int threads) {
+    static Position pos;
+    pos = *root;
+    if (depth < 1)
+        depth = 1;
+    ChessMove rootMoves[MAX_LEGAL_MOVES];
+    int numRoot = generateLegalMoves(&pos, rootMoves);
+    std::atomic<unsigned long long> rootCounts[MAX_LEGAL_MOVES];
+    for (int i = 0; i < numRoot; i++)
+        rootCounts[i] = (depth == 1) ? 1 : 0;
+    PerftQueue* queues = new PerftQueue[threads];
+    PerftJob job = { &pos, depth, threads, queues, rootCounts };
+
+    // Deal the work out round-robin. Splitting at the second ply gives the thieves
+    // something to take when a few root moves hold most of the tree.
+    long long start = now_ms();
+    int next = 0;
+    for (int i = 0; depth > 1 && i < numRoot; i++) {
+        PerftTask task;
+        task.rootIndex = i;
+        task.moves[0] = rootMoves[i];
+        task.numMoves = 1;
+        if (depth < 4) {
+            queues[next++ % threads].tasks.push_back(task);
+            continue;
+        }
+        ChessMove replies[MAX_LEGAL_MOVES];
+        make_move(&pos, rootMoves[i]);
+        int numReplies = generateLegalMoves(&pos, replies);
+        unmake_move(&pos);
+        task.numMoves = 2;
+        for (int j = 0; j < numReplies; j++) {
+            task.moves[1] = replies[j];
+            queues[next++ % threads].tasks.push_back(task);
+        }
+    }
+
+    std::thread* helpers = new std::thread[threads];
+    for (int i = 1; i < threads; i++)
+        helpers[i] = std::thread(perft_worker, &job, i);
+    perft_worker(&job, 0);
+    for (int i = 1; i < threads; i++)
+        helpers[i].join();
+    long long elapsed = now_ms() - start;
+    delete[] helpers;
+    delete[] queues;
+
+    unsigned long long total = 0;
+    for (int i = 0; i < numRoot; i++) {
+        output_move(rootMoves[i]);
+        printf(": %llu\n", rootCounts[i].load());
+        total += rootCounts[i];
+    }
+    printf("\nMoves: %d\nNodes: %llu\nTime: %lld ms\nNodes/sec: %llu\n", numRoot, total, elapsed,
+        elapsed ? total * 1000 / (unsigned long long)elapsed : total * 1000);
+}
+
+/*
+ * run_bench:
+ * Searches a fixed set of positions to a fixed depth, each with a cleared table, and
+ * reports time, nodes and nodes/sec. Run it with different --threads values to measure
+ * the parallel speedup to that depth.
+ */
+static const char* benchLines[] = {
+    "",
+    "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7",
+    "d2d4 g8f6 c2c4 e7e6 b1c3 f8b4 d1c2 e8g8",
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6",
+    "d2d4 d7d5 c2c4 c7c6 g1f3 g8f6 b1c3 d5c4 a2a4 c8f5",
+    "e2e4 e7e6 d2d4 d7d5 b1c3 g8f6 c1g5 f8e7 e4e5 f6d7 g5e7 d8e7 f2f4",
+    "c2c4 e7e5 b1c3 g8f6 g1f3 b8c6 g2g3 d7d5 c4d5 f6d5",
+    "e2e4 e7e5 g1f3 b8c6 d2d4 e5d4 f3d4 g8f6 d4c6 b7c6 e4e5 d8e7 d1e2 f6d5 c2c4",
+};
+
+void run_bench(SearchInfo* search, int depth) {
+    static Position pos;
+    SearchLimits savedLimits = search->limits;
+    search->limits.maxDepth = depth;
+    search->limits.maxNodes = 0;
+    search->limits.moveTimeMs = 0;
+
+    long long totalNodes = 0, totalMs = 0;
+    static SearchStats totalStats;
+    memset(&totalStats, 0, sizeof(totalStats));
+    int count = (int)(sizeof(benchLines) / sizeof(benchLines[0]));
+    for (int i = 0; i < count; i++) {
+        char line[256];
+        initialize_board(&pos);
+        strcpy(line, benchLines[i]);
+        for (char* token = strtok(line, " "); token; token = strtok(NULL, " "))
+            play_move_string(&pos, token);
+        tt_clear(search->tt);
+
+        long long start = now_ms();
+        ChessMove move = choose_best_move(&pos, search);
+        long long elapsed = now_ms() - start;
+        totalNodes += search->nodes;
+        totalMs += elapsed;
+        stats_add(&totalStats, &search->stats, 1);
+        if (statsJsonFile)
+            write_search_stats_json(statsJsonFile, &search->stats, search->completedDepth, search->bestScore, elapsed);
+        printf("position %d: ", i + 1);
+        output_move(move);
+        printf("  score %d  nodes %lld  time %lldms\n", search->bestScore, search->nodes, elapsed);
+    }
+    printf("threads %d  depth %d  nodes %lld  time %lldms  nps %lld\n", search->threads, depth,
+        totalNodes, totalMs, totalMs ? totalNodes * 1000 / totalMs : 0);
+    char summary[512];
+    format_search_stats(summary, sizeof(summary), &totalStats, totalMs);
+    printf("%s\n", summary);
+    search->limits = savedLimits;
+}
+
+// Batch analysis: workers take lines from the input under a lock and write one JSON line
+// per position as soon as it is done, so results stream in completion order.
+typedef struct {
+    FILE* input;
+    SearchLimits limits;
+    int disabledFeatures;
+    size_t hashMB;
+    TranspositionTable* sharedTT;   // Table for every worker (one kept in a file), or NULL.
+    std::mutex inputLock;
+    std::mutex outputLock;
+    long long lineNumber;
+    long long positions;
+    long long nodes;
+} AnalysisJob;
+
+static void analysis_worker(AnalysisJob* job) {
+    Position* pos = new Position();
+    SearchInfo* info = new SearchInfo();
+    TranspositionTable* tt = job->sharedTT;
+    if (!tt) {
+        tt = new TranspositionTable();
+        tt_resize(tt, job->hashMB);
+    }
+    info->tt = tt;
+    info->threads = 1;
+    info->limits = job->limits;
+    info->disabledFeatures = job->disabledFeatures;
+
+    char line[1024];
+    while (1) {
+        long long lineNumber;
+        {
+            std::lock_guard<std::mutex> guard(job->inputLock);
+            if (!fgets(line, sizeof(line), job->input))
+                break;
+            lineNumber = ++job->lineNumber;
+        }
+        line[strcspn(line, "\r\n")] = 0;
+        // The first four fields are the position; EPD operations or FEN clocks may follow.
+        char fields[4][80];
+        int fieldCount = sscanf(line, "%79s %79s %79s %79s", fields[0], fields[1], fields[2], fields[3]);
+        if (fieldCount <= 0 || line[0] == '#')
+            continue;
+        char fen[340] = "";
+        if (fieldCount == 4)
+            snprintf(fen, sizeof(fen), "%s %s %s %s", fields[0], fields[1], fields[2], fields[3]);
+        char result[1024];
+        if (fieldCount < 4 || !load_fen(pos, fen) || strchr(fen, '"') || strchr(fen, '\\')) {
+            snprintf(result, sizeof(result), "{\"line\":%lld,\"error\":\"invalid position\"}", lineNumber);
+        }
+        else {
+            long long start = now_ms();
+            ChessMove best = choose_best_move(pos, info);
+            long long elapsed = now_ms() - start;
+            char move[6];
+            if (is_null_move(best))
+                strcpy(move, "0000");
+            else
+                format_move_uci(best, move);
+            int length = snprintf(result, sizeof(result),
+                "{\"line\":%lld,\"fen\":\"%s\",\"bestmove\":\"%s\",\"score\":%d,", lineNumber, fen, move,
+                info->bestScore);
+            if (info->bestScore >= MATE_BOUND || info->bestScore <= -MATE_BOUND)
+                length += snprintf(result + length, sizeof(result) - length, "\"mate\":%d,",
+                    info->bestScore > 0 ? (MATE_SCORE - info->bestScore + 1) / 2 : -(MATE_SCORE + info->bestScore) / 2);
+            snprintf(result + length, sizeof(result) - length, "\"depth\":%d,\"nodes\":%lld,\"time_ms\":%lld}",
+                info->completedDepth, info->nodes, elapsed);
+        }
+        std::lock_guard<std::mutex> guard(job->outputLock);
+        puts(result);
+        fflush(stdout);
+        job->positions++;
+        job->nodes += info->nodes;
+    }
+    if (tt != job->sharedTT) {
+        tt_release(tt);
+        delete tt;
+    }
+    free(info->evalCache);
+    delete info;
+    delete pos;
+}
+
+/*
+ * run_analysis:
+ * Analyses every position of an EPD or FEN file (one per line, "-" for stdin) with
+ * choose_best_move under the given limits, on `threads` workers that each search one
+ * position at a time with their own hash table, or all with sharedTT if it is given.
+ * Scores are in centipawns from the side to move's view. A summary with positions/sec
+ * goes to stderr so stdout stays JSONL.
+ */
+int run_analysis(const char* path, SearchLimits limits, int disabledFeatures, int threads, size_t hashMB,
+                 TranspositionTable* sharedTT) {
+    AnalysisJob job;
+    job.input = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!job.input) {
+        fprintf(stderr, "Could not open %s.\n", path);
+        return 0;
+    }
+    job.limits = limits;
+    job.disabledFeatures = disabledFeatures;
+    job.hashMB = hashMB;
+    job.sharedTT = sharedTT;
+    job.lineNumber = 0;
+    job.positions = 0;
+    job.nodes = 0;
+
+    long long start = now_ms();
+    std::thread* workers = new std::thread[threads];
+    for (int i = 0; i < threads; i++)
+        workers[i] = std::thread(analysis_worker, &job);
+    for (int i = 0; i < threads; i++)
+        workers[i].join();
+    delete[] workers;
+    long long elapsed = now_ms() - start;
+    if (job.input != stdin)
+        fclose(job.input);
+
+    fprintf(stderr, "positions %lld  time %lldms  positions/sec %.1f  nodes %lld  nps %lld\n", job.positions,
+        elapsed, elapsed ? job.positions * 1000.0 / elapsed : 0.0, job.nodes,
+        elapsed ? job.nodes * 1000 / elapsed : 0);
+    return 1;
+}
+
+// Engine-vs-engine matches. Two configurations of this engine play pairs of games from
+// each opening, one game with each color, on a pool of workers that play one game at a
+// time each. A sequential probability ratio test decides between "B is no stronger than
+// A by elo0" and "B is stronger by elo1" and ends the match as soon as it can.
+#define MATCH_MAX_PLIES 400           // Longer games are adjudicated drawn.
+#define MATCH_DEFAULT_GAMES 100
+#define MATCH_DEFAULT_MOVETIME 100
+#define SPRT_ALPHA 0.05
+#define SPRT_BETA 0.05
+
+typedef struct {
+    char name[64];
+    SearchLimits limits;
+    int disabledFeatures;
+    size_t hashMB;
+} EngineConfig;
+
+typedef struct {
+    EngineConfig engines[2];          // A and B.
+    char (*openings)[340];
+    int openingCount;
+    int maxGames;
+    double elo0, elo1;
+    std::atomic<int> nextGame;
+    std::atomic<int> stop;            // Set once the SPRT has decided.
+    std::mutex resultLock;            // Guards everything below.
+    int wins, draws, losses;          // From B's point of view.
+    long long nodes[2];
+    long long searchMs[2];
+    long long startTime;
+} MatchJob;
+
+/*
+ * parse_engine_config:
+ * Applies a comma-separated list of settings to an engine configuration: depth=<n>,
+ * nodes=<n>, movetime=<ms>, hash=<MB>, and no-pvs, no-null-move, no-lmr or
+ * no-check-extension (or the same without "no-" to switch a technique back on).
+ * Returns 0 on an unknown setting.
+ */
+int parse_engine_config(const char* text, EngineConfig* config) {
+    static const struct {
+        const char* name;
+        int flag;
+    } features[] = {
+        { "pvs", FEATURE_PVS },
+        { "null-move", FEATURE_NULL_MOVE },
+        { "lmr", FEATURE_LMR },
+        { "check-extension", FEATURE_CHECK_EXTENSION },
+    };
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", text);
+    for (char* token = strtok(buffer, ", "); token; token = strtok(NULL, ", ")) {
+        char* value = strchr(token, '=');
+        if (value) {
+            *value++ = 0;
+            if (!strcmp(token, "depth")) config->limits.maxDepth = atoi(value);
+            else if (!strcmp(token, "nodes")) config->limits.maxNodes = atoll(value);
+            else if (!strcmp(token, "movetime")) config->limits.moveTimeMs = atoll(value);
+            else if (!strcmp(token, "hash") && atoi(value) > 0) config->hashMB = (size_t)atoi(value);
+            else return 0;
+            continue;
+        }
+        int off = !strncmp(token, "no-", 3);
+        int found = 0;
+        for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); i++) {
+            if (strcmp(token + (off ? 3 : 0), features[i].name))
+                continue;
+            if (off)
+                config->disabledFeatures |= features[i].flag;
+            else
+                config->disabledFeatures &= ~features[i].flag;
+            found = 1;
+        }
+        if (!found)
+            return 0;
+    }
+    if (text[0])
+        snprintf(config->name, sizeof(config->name), "%s", text);
+    return 1;
+}
+
+/*
+ * match_score / match_elo / sprt_llr:
+ * Statistics of a match result from B's point of view. match_score gives the mean
+ * score and its variance per game, match_elo the Elo difference with a 95% margin, and
+ * sprt_llr the log-likelihood ratio of elo1 against elo0 in the normal approximation to
+ * the trinomial model.
+ */
+static void match_score(double wins, double draws, double losses, double* score, double* variance) {
+    double games = wins + draws + losses;
+    double w = wins / games, d = draws / games;
+    *score = w + d / 2;
+    *variance = w + d / 4 - *score * *score;
+}
+
+static double elo_from_score(double score) {
+    if (score <= 0.0) return -INFINITY;
+    if (score >= 1.0) return INFINITY;
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+static void match_elo(int wins, int draws, int losses, double* elo, double* margin) {
+    double score, variance;
+    match_score(wins, draws, losses, &score, &variance);
+    double deviation = sqrt(variance / (wins + draws + losses));
+    *elo = elo_from_score(score);
+    *margin = (elo_from_score(score + 1.96 * deviation) - elo_from_score(score - 1.96 * deviation)) / 2;
+}
+
+static double sprt_llr(int wins, int draws, int losses, double elo0, double elo1) {
+    // Half a game is added to each outcome so that a one-sided result still has a
+    // variance to work with.
+    double score, variance;
+    match_score(wins + 0.5, draws + 0.5, losses + 0.5, &score, &variance);
+    double s0 = 1.0 / (1.0 + pow(10.0, -elo0 / 400.0));
+    double s1 = 1.0 / (1.0 + pow(10.0, -elo1 / 400.0));
+    return (s1 - s0) * (2 * score - s0 - s1) / (2 * variance / (wins + draws + losses + 1.5));
+}
+
+/*
+ * insufficient_material:
+ * True when neither side can mate: bare kings, or one knight or bishop between them.
+ */
+static int insufficient_material(const Position* pos) {
+    const BoardState* board = &pos->board;
+    Bitboard heavy = 0;
+    for (int side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+        heavy |= board->pieces[side][PAWN] | board->pieces[side][ROOK] | board->pieces[side][QUEEN];
+    return !heavy && popcount(board->occupied) <= 3;
+}
+
+/*
+ * play_match_game:
+ * Plays one game from the position in pos, with infos[engineOf[side]] choosing each
+ * side's moves. Adds each engine's nodes and search time to the totals, and returns the
+ * winning side, or NO_SIDE for a draw by stalemate, repetition, the fifty-move rule,
+ * insufficient material or length.
+ */
+static int play_match_game(Position* pos, SearchInfo* infos[2], const int engineOf[2], long long nodes[2],
+                           long long searchMs[2]) {
+    for (int ply = 0; ply < MATCH_MAX_PLIES; ply++) {
+        ChessMove moves[MAX_LEGAL_MOVES];
+        if (generateLegalMoves(pos, moves) == 0)
+            return isKingInCheck(&pos->board, pos->sideToMove) ? (pos->sideToMove ^ 1) : NO_SIDE;
+        if (pos->halfmoveClock >= FIFTY_MOVE_PLIES || insufficient_material(pos) || is_repetition(pos, 2))
+            return NO_SIDE;
+
+        int engine = engineOf[pos->sideToMove];
+        long long start = now_ms();
+        ChessMove move = choose_best_move(pos, infos[engine]);
+        searchMs[engine] += now_ms() - start;
+        nodes[engine] += infos[engine]->nodes;
+        make_game_move(pos, move);
+    }
+    return NO_SIDE;
+}
+
+static void match_worker(MatchJob* job) {
+    Position* pos = new Position();
+    SearchInfo* infos[2];
+    TranspositionTable* tts[2];
+    for (int engine = 0; engine < 2; engine++) {
+        tts[engine] = new TranspositionTable();
+        tt_resize(tts[engine], job->engines[engine].hashMB);
+        infos[engine] = new SearchInfo();
+        infos[engine]->tt = tts[engine];
+        infos[engine]->threads = 1;
+        infos[engine]->limits = job->engines[engine].limits;
+        infos[engine]->disabledFeatures = job->engines[engine].disabledFeatures;
+    }
+
+    while (!job->stop.load()) {
+        int game = job->nextGame.fetch_add(1);
+        if (game >= job->maxGames)
+            break;
+        // Even games give A the side to move in the opening, odd games give it to B.
+        load_fen(pos, job->openings[(game / 2) % job->openingCount]);
+        int engineOf[2];
+        engineOf[pos->sideToMove] = game & 1;
+        engineOf[pos->sideToMove ^ 1] = (game & 1) ^ 1;
+        tt_clear(tts[0]);
+        tt_clear(tts[1]);
+        long long nodes[2] = { 0, 0 }, searchMs[2] = { 0, 0 };
+        int winner = play_match_game(pos, infos, engineOf, nodes, searchMs);
+
+        std::lock_guard<std::mutex> guard(job->resultLock);
+        if (winner == NO_SIDE)
+            job->draws++;
+        else if (engineOf[winner] == 1)
+            job->wins++;
+        else
+            job->losses++;
+        for (int engine = 0; engine < 2; engine++) {
+            job->nodes[engine] += nodes[engine];
+            job->searchMs[engine] += searchMs[engine];
+        }
+        int games = job->wins + job->draws + job->losses;
+        double elo, margin;
+        match_elo(job->wins, job->draws, job->losses, &elo, &margin);
+        double llr = sprt_llr(job->wins, job->draws, job->losses, job->elo0, job->elo1);
+        printf("game %d: %s  B +%d -%d =%d  elo %.1f +/- %.1f  llr %.2f (%.2f, %.2f)\n", games,
+            winner == NO_SIDE ? "1/2-1/2" : winner == SIDE_WHITE ? "1-0" : "0-1", job->wins, job->losses,
+            job->draws, elo, margin, llr, log(SPRT_BETA / (1 - SPRT_ALPHA)), log((1 - SPRT_BETA) / SPRT_ALPHA));
+        fflush(stdout);
+        if (llr <= log(SPRT_BETA / (1 - SPRT_ALPHA)) || llr >= log((1 - SPRT_BETA) / SPRT_ALPHA))
+            job->stop.store(1);
+    }
+
+    for (int engine = 0; engine < 2; engine++) {
+        tt_release(tts[engine]);
+        delete tts[engine];
+        free(infos[engine]->evalCache);
+        delete infos[engine];
+    }
+    delete pos;
+}
+
+/*
+ * run_match:
+ * Plays up to maxGames games between engines A and B from the openings in an EPD or FEN
+ * file, on `concurrency` workers, and reports the result from B's point of view: Elo
+ * difference with a 95% margin, the SPRT verdict, games/sec and each side's nodes/sec.
+ */
+int run_match(const char* path, EngineConfig engines[2], int maxGames, int concurrency, double elo0, double elo1) {
+    FILE* input = fopen(path, "r");
+    if (!input) {
+        printf("Could not open %s.\n", path);
+        return 0;
+    }
+    MatchJob* job = new MatchJob();
+    int capacity = 0;
+    char line[1024];
+    Position* check = new Position();
+    while (fgets(line, sizeof(line), input)) {
+        // The first four fields are the position; EPD operations or FEN clocks may follow.
+        char fields[4][80];
+        if (line[0] == '#' || sscanf(line, "%79s %79s %79s %79s", fields[0], fields[1], fields[2], fields[3]) != 4)
+            continue;
+        char fen[340];
+        snprintf(fen, sizeof(fen), "%s %s %s %s", fields[0], fields[1], fields[2], fields[3]);
+        if (!load_fen(check, fen))
+            continue;
+        if (job->openingCount == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            job->openings = (char(*)[340])realloc(job->openings, capacity * sizeof(*job->openings));
+        }
+        strcpy(job->openings[job->openingCount++], fen);
+    }
+    delete check;
+    fclose(input);
+    if (!job->openingCount) {
+        printf("No valid positions in %s.\n", path);
+        delete job;
+        return 0;
+    }
+
+    job->engines[0] = engines[0];
+    job->engines[1] = engines[1];
+    job->maxGames = maxGames;
+    job->elo0 = elo0;
+    job->elo1 = elo1;
+    printf("A: %s  B: %s  openings %d  games %d  workers %d  SPRT elo0 %.1f elo1 %.1f\n", engines[0].name,
+        engines[1].name, job->openingCount, maxGames, concurrency, elo0, elo1);
+    job->startTime = now_ms();
+    std::thread* workers = new std::thread[concurrency];
+    for (int i = 0; i < concurrency; i++)
+        workers[i] = std::thread(match_worker, job);
+    for (int i = 0; i < concurrency; i++)
+        workers[i].join();
+    delete[] workers;
+    long long elapsed = now_ms() - job->startTime;
+
+    int games = job->wins + job->draws + job->losses;
+    if (games) {
+        double elo, margin;
+        match_elo(job->wins, job->draws, job->losses, &elo, &margin);
+        double llr = sprt_llr(job->wins, job->draws, job->losses, elo0, elo1);
+        printf("\ngames %d  B +%d -%d =%d  score %.1f%%  elo %.1f +/- %.1f\n", games, job->wins, job->losses,
+            job->draws, 100.0 * (job->wins + job->draws / 2.0) / games, elo, margin);
+        printf("SPRT: llr %.2f, %s\n", llr,
+            llr >= log((1 - SPRT_BETA) / SPRT_ALPHA) ? "H1 accepted (B is stronger)" :
+            llr <= log(SPRT_BETA / (1 - SPRT_ALPHA)) ? "H0 accepted (B is not stronger)" : "inconclusive");
+        printf("time %lldms  games/sec %.2f\n", elapsed, elapsed ? games * 1000.0 / elapsed : 0.0);
+        for (int engine = 0; engine < 2; engine++)
+            printf("%c (%s): nodes %lld  nps %lld\n", 'A' + engine, job->engines[engine].name, job->nodes[engine],
+                job->searchMs[engine] ? job->nodes[engine] * 1000 / job->searchMs[engine] : 0);
+    }
+    free(job->openings);
+    delete job;
+    return 1;
+}
+
+// UCI front end state. The search runs on its own thread so that the command loop can
+// answer "stop" and "isready" while it thinks.
+static Position uciPosition;
+static Position uciSearchPosition;
+static std::thread uciSearchThread;
+static int uciInfinite;
+
+// Search techniques offered as UCI check options.
+static const struct {
+    const char* name;
+    int flag;
+} uciFeatures[] = {
+    { "PVS", FEATURE_PVS },
+    { "NullMove", FEATURE_NULL_MOVE },
+    { "LMR", FEATURE_LMR },
+    { "CheckExtension", FEATURE_CHECK_EXTENSION },
+};
+#define UCI_FEATURE_COUNT ((int)(sizeof(uciFeatures) / sizeof(uciFeatures[0])))
+
+static void uci_search(SearchInfo* search) {
+    ChessMove best, reply;
+    int hasReply = 0;
+    if (book_move(&openingBook, &uciSearchPosition, &best))
+        uci_send("info string book move");
+    else {
+        best = choose_best_move(&uciSearchPosition, search);
+        long long elapsed = now_ms() - search->startTime;
+        char summary[512];
+        format_search_stats(summary, sizeof(summary), &search->stats, elapsed);
+        uci_send("info string %s", summary);
+        if (statsJsonFile)
+            write_search_stats_json(statsJsonFile, &search->stats, search->completedDepth, search->bestScore, elapsed);
+        hasReply = ponder_move(&uciSearchPosition, search, &reply);
+    }
+    // After "go infinite" or "go ponder" the best move is only sent once the GUI says
+    // "stop" (or "ponderhit").
+    while ((uciInfinite || search->pondering.load()) && !search->stopRequested.load())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    char move[6], ponder[6];
+    if (is_null_move(best))
+        strcpy(move, "0000");
+    else
+        format_move_uci(best, move);
+    if (hasReply) {
+        format_move_uci(reply, ponder);
+        uci_send("bestmove %s ponder %s", move, ponder);
+    }
+    else {
+        uci_send("bestmove %s", move);
+    }
+}
+
+static void uci_stop_search(SearchInfo* search) {
+    if (uciSearchThread.joinable()) {
+        search->stopRequested.store(1);
+        uciSearchThread.join();
+    }
+}
+
+static int starts_with_word(const char* text, const char* word) {
+    size_t length = strlen(word);
+    return !strncmp(text, word, length) && (!text[length] || text[length] == ' ' || text[length] == '\t');
+}
+
+/*
+ * parse_position:
+ * Sets pos from "[startpos | fen <fen>] [moves <m1> <m2> ...]"; with the position left
+ * out the moves are played from the start position. Returns 0 if the FEN or one of the
+ * moves is not valid, leaving pos half set up.
+ */
+int parse_position(Position* pos, char* args) {
+    while (*args == ' ' || *args == '\t') args++;
+    char* moves = NULL;
+    if (starts_with_word(args, "moves")) {
+        moves = args + 5;
+        *args = 0;
+    }
+    else {
+        for (char* found = strstr(args, " moves"); found; found = strstr(found + 1, " moves")) {
+            if (starts_with_word(found + 1, "moves")) {
+                *found = 0;
+                moves = found + 6;
+                break;
+            }
+        }
+    }
+    if (!*args || starts_with_word(args, "startpos"))
+        initialize_board(pos);
+    else if (!starts_with_word(args, "fen") || !load_fen(pos, args + 3))
+        return 0;
+    if (moves)
+        for (char* token = strtok(moves, " \t"); token; token = strtok(NULL, " \t"))
+            if (!play_move_string(pos, token))
+                return 0;
+    return 1;
+}
+
+/*
+ * uci_position:
+ * Handles "position". Returns 0 if it is not valid, in which case the previous position
+ * is kept.
+ */
+static int uci_position(char* args) {
+    static Position pos;
+    if (!parse_position(&pos, args))
+        return 0;
+    uciPosition = pos;
+    return 1;
+}
+
+/*
+ * uci_go:
+ * Handles "go" with depth, nodes, movetime, wtime/btime/winc/binc/movestogo, infinite and
+ * ponder, and starts the search thread. With a clock the move gets its share of the
+ * remaining time plus most of the increment, never closer than 50ms to the flag. After
+ * "go ponder" that budget only starts with "ponderhit".
+ */
+static void uci_go(SearchInfo* search, char* args) {
+    long long time[2] = { 0, 0 }, increment[2] = { 0, 0 };
+    int movesToGo = 0, ponder = 0;
+    search->limits.maxDepth = 0;
+    search->limits.maxNodes = 0;
+    search->limits.moveTimeMs = 0;
+    uciInfinite = 0;
+    for (char* token = strtok(args, " \t"); token; token = strtok(NULL, " \t")) {
+        char* value = NULL;
+        if (!strcmp(token, "infinite"))
+            uciInfinite = 1;
+        else if (!strcmp(token, "ponder"))
+            ponder = 1;
+        else
+            value = strtok(NULL, " \t");
+        if (!value) continue;
+        if (!strcmp(token, "depth")) search->limits.maxDepth = atoi(value);
+        else if (!strcmp(token, "nodes")) search->limits.maxNodes = atoll(value);
+        else if (!strcmp(token, "movetime")) search->limits.moveTimeMs = atoll(value);
+        else if (!strcmp(token, "wtime")) time[SIDE_WHITE] = atoll(value);
+        else if (!strcmp(token, "btime")) time[SIDE_BLACK] = atoll(value);
+        else if (!strcmp(token, "winc")) increment[SIDE_WHITE] = atoll(value);
+        else if (!strcmp(token, "binc")) increment[SIDE_BLACK] = atoll(value);
+        else if (!strcmp(token, "movestogo")) movesToGo = atoi(value);
+    }
+    int side = uciPosition.sideToMove;
+    if (!search->limits.moveTimeMs && time[side] > 0) {
+        long long budget = time[side] / (movesToGo > 0 ? movesToGo : 30) + increment[side] * 3 / 4;
+        if (budget > time[side] - 50)
+            budget = time[side] - 50;
+        search->limits.moveTimeMs = budget > 1 ? budget : 1;
+    }
+
+    uciSearchPosition = uciPosition;
+    search->stopRequested.store(0);
+    search->pondering.store(ponder);
+    search->uciOutput = 1;
+    uciSearchThread = std::thread(uci_search, search);
+}
+
+/*
+ * uci_loop:
+ * Speaks the UCI protocol on stdin/stdout until "quit" or end of input.
+ */
+void uci_loop(SearchInfo* search) {
+    static char line[65536];
+    initialize_board(&uciPosition);
+    uci_send("id name ChessGameVs.AI");
+    uci_send("id author willws-coding");
+    uci_send("option name Hash type spin default %d min 1 max 65536", DEFAULT_HASH_MB);
+    uci_send("option name Threads type spin default 1 min 1 max %d", MAX_THREADS);
+    uci_send("option name Ponder type check default false");
+    for (int i = 0; i < UCI_FEATURE_COUNT; i++)
+        uci_send("option name %s type check default %s", uciFeatures[i].name,
+            (search->disabledFeatures & uciFeatures[i].flag) ? "false" : "true");
+    uci_send("uciok");
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = 0;
+        char* args = line + strcspn(line, " \t");
+        if (*args) *args++ = 0;
+
+        if (!strcmp(line, "uci")) {
+            uci_send("uciok");
+        }
+        else if (!strcmp(line, "isready")) {
+            uci_send("readyok");
+        }
+        else if (!strcmp(line, "stop")) {
+            uci_stop_search(search);
+        }
+        else if (!strcmp(line, "ponderhit")) {
+            ponder_hit(search);
+        }
+        else if (!strcmp(line, "quit")) {
+            break;
+        }
+        else if (!strcmp(line, "ucinewgame")) {
+            // A table kept in a file is there to be reused, so it is not wiped.
+            uci_stop_search(search);
+            if (!search->tt->file)
+                tt_clear(search->tt);
+            initialize_board(&uciPosition);
+        }
+        else if (!strcmp(line, "position")) {
+            uci_stop_search(search);
+            if (!uci_position(args))
+                uci_send("info string invalid position");
+        }
+        else if (!strcmp(line, "go")) {
+            uci_stop_search(search);
+            uci_go(search, args);
+        }
+        else if (!strcmp(line, "setoption")) {
+            // setoption name <Hash|Threads> value <n>, or name <feature> value <true|false>
+            char name[64], value[16];
+            uci_stop_search(search);
+            if (sscanf(args, "name %63s value %15s", name, value) == 2) {
+                if (!strcmp(name, "Hash") && atoi(value) > 0)
+                    tt_resize(search->tt, (size_t)atoi(value));
+                else if (!strcmp(name, "Threads") && atoi(value) > 0)
+                    search->threads = atoi(value) > MAX_THREADS ? MAX_THREADS : atoi(value);
+                for (int i = 0; i < UCI_FEATURE_COUNT; i++) {
+                    if (strcmp(name, uciFeatures[i].name))
+                        continue;
+                    if (!strcmp(value, "false"))
+                        search->disabledFeatures |= uciFeatures[i].flag;
+                    else
+                        search->disabledFeatures &= ~uciFeatures[i].flag;
+                }
+            }
+        }
+        else if (!strcmp(line, "d")) {
+            display_board(&uciPosition);
+            fflush(stdout);
+        }
+    }
+    uci_stop_search(search);
+}
+
+// Engine server: one process keeps many independent games, each with a position of its
+// own, and answers search requests for them on a shared pool of workers. Commands and replies
+// are lines on stdin/stdout, every one tagged with the game's id so that many clients'
+// games can be multiplexed over the one stream. Replies to a game's requests come in the
+// order they were sent, but replies for different games interleave as searches finish.
+#define SERVER_ID_LENGTH 32
+#define SERVER_GAME_BUCKETS 4096        // A power of two.
+#define SERVER_MAX_GAMES 65536
+#define SERVER_DEFAULT_QUEUE 64
+#define SERVER_LATENCY_SAMPLES 4096     // Latencies kept for the percentiles.
+
+// A game is kept compactly, as the position after its last capture or pawn move (or the
+// one it was set up from) and the moves played since, a few hundred bytes in all. It is
+// turned back into a Position, with those moves on the undo stack for the repetition
+// checks, only to be searched or to have moves played in it.
+typedef struct ServerGame {
+    char id[SERVER_ID_LENGTH];
+    char squares[BOARD_DIM][BOARD_DIM]; // The root position.
+    int sideToMove;
+    int castlingRights;
+    int enPassantSquare;
+    int halfmoveClock;
+    int fullmoveNumber;
+    unsigned short moves[FIFTY_MOVE_PLIES]; // Moves since the root, packed with pack_move.
+    int moveCount;
+    int searching;                      // A search is queued or running; the game is the worker's until it ends.
+    int ended;                          // "end" came during the search; the worker frees the game.
+    struct ServerGame* next;            // Next game in the same bucket.
+} ServerGame;
+
+typedef struct {
+    ServerGame* game;
+    SearchLimits limits;
+    long long received;                 // When the request was accepted; its time budget runs from here.
+} ServerRequest;
+
+typedef struct {
+    TranspositionTable* tt;             // Shared by all workers, as in Lazy SMP.
+    SearchLimits defaultLimits;
+    int disabledFeatures;
+    int queueCapacity;
+    ServerGame* buckets[SERVER_GAME_BUCKETS]; // Only the command loop touches the game index.
+    int gameCount;
+    // Guarded by lock:
+    std::mutex lock;
+    std::condition_variable wakeup;
+    std::deque<ServerRequest> queue;
+    int closing;
+    int running;
+    long long served;
+    long long rejected;
+    long long nodes;
+    long long latencies[SERVER_LATENCY_SAMPLES]; // Ring buffer of the most recent request latencies.
+    long long started;
+} Server;
+
+static ServerGame** server_find(Server* server, const char* id) {
+    unsigned int hash = 2166136261u;
+    for (const char* c = id; *c; c++)
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    ServerGame** link = &server->buckets[hash & (SERVER_GAME_BUCKETS - 1)];
+    while (*link && strcmp((*link)->id, id))
+        link = &(*link)->next;
+    return link;
+}
+
+/*
+ * server_game_save / server_game_setup:
+ * Store a position in a game, keeping at most FIFTY_MOVE_PLIES moves before it, and set
+ * a Position up from a game. Saving takes the moves back on `work`, which may be any
+ * spare Position.
+ */
+static void server_game_save(ServerGame* game, const Position* pos, Position* work) {
+    int keep = (pos->halfmoveClock < pos->undoCount) ? pos->halfmoveClock : pos->undoCount;
+    if (keep > FIFTY_MOVE_PLIES)
+        keep = FIFTY_MOVE_PLIES;
+    *work = *pos;
+    for (int i = 0; i < keep; i++)
+        unmake_move(work);
+    memcpy(game->squares, work->board.squares, sizeof(game->squares));
+    game->sideToMove = work->sideToMove;
+    game->castlingRights = work->castlingRights;
+    game->enPassantSquare = work->enPassantSquare;
+    game->halfmoveClock = work->halfmoveClock;
+    game->fullmoveNumber = work->fullmoveNumber;
+    for (int i = 0; i < keep; i++)
+        game->moves[i] = pack_move(pos->undoStack[pos->undoCount - keep + i].move);
+    game->moveCount = keep;
+}
+
+static void server_game_setup(const ServerGame* game, Position* pos) {
+    clear_board(pos);
+    for (int square = 0; square < BOARD_SQUARES; square++)
+        if (game->squares[ROW_OF(square)][COL_OF(square)] != EMPTY_CELL)
+            put_piece(pos, square, game->squares[ROW_OF(square)][COL_OF(square)]);
+    pos->sideToMove = game->sideToMove;
+    pos->castlingRights = game->castlingRights;
+    pos->enPassantSquare = game->enPassantSquare;
+    pos->halfmoveClock = game->halfmoveClock;
+    pos->fullmoveNumber = game->fullmoveNumber;
+    pos->undoCount = 0;
+    if (pos->sideToMove == SIDE_BLACK)
+        pos->key ^= zobristBlackToMove;
+    pos->key ^= zobristCastling[pos->castlingRights];
+    if (pos->enPassantSquare != -1)
+        pos->key ^= zobristEnPassant[COL_OF(pos->enPassantSquare)];
+    for (int i = 0; i < game->moveCount; i++)
+        make_game_move(pos, unpack_move(game->moves[i]));
+}
+
+static int compare_long_long(const void* a, const void* b) {
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * server_report:
+ * Formats the server's metrics: games open, queue depth, searches running, moves served
+ * and served per second since the start, nodes/sec, the 50th, 90th and 99th percentile
+ * and the maximum of the recent request latencies (queueing included) and the requests
+ * turned away because the queue was full. Takes the lock.
+ */
+static void server_report(Server* server, char* out, size_t size) {
+    static long long sorted[SERVER_LATENCY_SAMPLES];
+    std::lock_guard<std::mutex> guard(server->lock);
+    int count = server->served < SERVER_LATENCY_SAMPLES ? (int)server->served : SERVER_LATENCY_SAMPLES;
+    memcpy(sorted, server->latencies, count * sizeof(sorted[0]));
+    qsort(sorted, count, sizeof(sorted[0]), compare_long_long);
+    long long percentile[3] = { 0, 0, 0 };
+    static const int percents[3] = { 50, 90, 99 };
+    for (int i = 0; i < 3 && count; i++)
+        percentile[i] = sorted[(count - 1) * percents[i] / 100];
+    long long elapsed = now_ms() - server->started;
+    snprintf(out, size, "games %d queue %d/%d running %d served %lld moves/sec %.1f nps %lld "
+        "latency p50 %lld p90 %lld p99 %lld max %lld rejected %lld",
+        server->gameCount, (int)server->queue.size(), server->queueCapacity, server->running, server->served,
+        elapsed ? server->served * 1000.0 / elapsed : 0.0, elapsed ? server->nodes * 1000 / elapsed : 0,
+        percentile[0], percentile[1], percentile[2], count ? sorted[count - 1] : 0, server->rejected);
+}
+
+/*
+ * server_worker:
+ * Takes search requests off the queue until the server closes. The engine's move is
+ * played in the game before the reply goes out, so the client only sends its own moves.
+ * A request's time budget counts the time it waited in the queue; once that is used up
+ * the search still completes depth 1.
+ */
+static void server_worker(Server* server) {
+    Position* pos = new Position();
+    Position* work = new Position();
+    SearchInfo* info = new SearchInfo();
+    info->tt = server->tt;
+    info->threads = 1;
+    info->disabledFeatures = server->disabledFeatures;
+    while (1) {
+        ServerRequest request;
+        {
+            std::unique_lock<std::mutex> guard(server->lock);
+            while (server->queue.empty() && !server->closing)
+                server->wakeup.wait(guard);
+            if (server->queue.empty())
+                break;
+            request = server->queue.front();
+            server->queue.pop_front();
+            server->running++;
+        }
+        ServerGame* game = request.game;
+        info->limits = request.limits;
+        if (info->limits.moveTimeMs) {
+            long long left = request.limits.moveTimeMs - (now_ms() - request.received);
+            info->limits.moveTimeMs = left > 1 ? left : 1;
+        }
+        server_game_setup(game, pos);
+        ChessMove best = choose_best_move(pos, info);
+        char move[6] = "0000";
+        if (!is_null_move(best)) {
+            format_move_uci(best, move);
+            make_game_move(pos, best);
+            server_game_save(game, pos, work);
+        }
+        long long latency = now_ms() - request.received;
+
+        // The reply goes out under the lock so that it cannot be overtaken by the reply to
+        // a request the client sends for this game as soon as the flag is clear.
+        std::lock_guard<std::mutex> guard(server->lock);
+        uci_send("bestmove %s %s score %d depth %d nodes %lld time %lld", game->id, move, info->bestScore,
+            info->completedDepth, info->nodes, latency);
+        server->latencies[server->served % SERVER_LATENCY_SAMPLES] = latency;
+        server->served++;
+        server->nodes += info->nodes;
+        server->running--;
+        game->searching = 0;
+        if (game->ended)
+            delete game;
+    }
+    free(info->evalCache);
+    delete info;
+    delete work;
+    delete pos;
+}
+
+/*
+ * server_command:
+ * Handles one command line. Returns 0 for "quit".
+ *   new <id> [startpos | fen <fen>] [moves <m1> ...]   starts or restarts a game
+ *   move <id> <m1> [<m2> ...]                          plays moves in it
+ *   go <id> [movetime <ms>] [depth <n>] [nodes <n>]    searches and plays the engine's move
+ *   end <id>                                           closes it
+ *   stats                                              reports the metrics
+ * Replies are "ok <id>", "error <id> <reason>", "bestmove <id> <move> score <cp> depth <n>
+ * nodes <n> time <ms>" and "stats ...". When the queue is full "go" is answered with
+ * "busy <id>" and should be sent again later.
+ */
+static int server_command(Server* server, char* line) {
+    static Position scratch, work;
+    char* args = line + strcspn(line, " \t");
+    if (*args) *args++ = 0;
+    if (!strcmp(line, "quit"))
+        return 0;
+    if (!strcmp(line, "stats")) {
+        char report[512];
+        server_report(server, report, sizeof(report));
+        uci_send("stats %s", report);
+        return 1;
+    }
+    if (!*line)
+        return 1;
+    if (strcmp(line, "new") && strcmp(line, "move") && strcmp(line, "go") && strcmp(line, "end")) {
+        uci_send("error - unknown command %s", line);
+        return 1;
+    }
+    char* id = args + strspn(args, " \t");
+    args = id + strcspn(id, " \t");
+    if (*args) *args++ = 0;
+    if (!*id || strlen(id) >= SERVER_ID_LENGTH) {
+        uci_send("error %s invalid game id", *id ? id : "-");
+        return 1;
+    }
+    ServerGame** link = server_find(server, id);
+    ServerGame* game = *link;
+    int searching;
+    {
+        std::lock_guard<std::mutex> guard(server->lock);
+        searching = game && game->searching;
+    }
+
+    if (!strcmp(line, "new")) {
+        if (searching) {
+            uci_send("error %s searching", id);
+            return 1;
+        }
+        if (!game && server->gameCount >= SERVER_MAX_GAMES) {
+            uci_send("error %s too many games", id);
+            return 1;
+        }
+        while (*args == ' ' || *args == '\t') args++;
+        if (!*args)
+            initialize_board(&scratch);
+        else if (!parse_position(&scratch, args)) {
+            uci_send("error %s invalid position", id);
+            return 1;
+        }
+        if (!game) {
+            game = new ServerGame();
+            snprintf(game->id, sizeof(game->id), "%s", id);
+            *link = game;
+            server->gameCount++;
+        }
+        server_game_save(game, &scratch, &work);
+        uci_send("ok %s", id);
+    }
+    else if (!game) {
+        uci_send("error %s no such game", id);
+    }
+    else if (!strcmp(line, "end")) {
+        // A game that is being searched is freed by its worker once the reply is out.
+        *link = game->next;
+        server->gameCount--;
+        std::lock_guard<std::mutex> guard(server->lock);
+        if (game->searching)
+            game->ended = 1;
+        else
+            delete game;
+        uci_send("ok %s", id);
+    }
+    else if (searching) {
+        uci_send("error %s searching", id);
+    }
+    else if (!strcmp(line, "move")) {
+        server_game_setup(game, &scratch);
+        for (char* token = strtok(args, " \t"); token; token = strtok(NULL, " \t")) {
+            if (!play_move_string(&scratch, token)) {
+                uci_send("error %s illegal move %s", id, token);
+                return 1;
+            }
+        }
+        server_game_save(game, &scratch, &work);
+        uci_send("ok %s", id);
+    }
+    else {
+        ServerRequest request;
+        memset(&request.limits, 0, sizeof(request.limits));
+        for (char* token = strtok(args, " \t"); token; token = strtok(NULL, " \t")) {
+            char* value = strtok(NULL, " \t");
+            if (!value) break;
+            if (!strcmp(token, "depth")) request.limits.maxDepth = atoi(value);
+            else if (!strcmp(token, "nodes")) request.limits.maxNodes = atoll(value);
+            else if (!strcmp(token, "movetime")) request.limits.moveTimeMs = atoll(value);
+        }
+        if (!request.limits.maxDepth && !request.limits.maxNodes && !request.limits.moveTimeMs)
+            request.limits = server->defaultLimits;
+        request.game = game;
+        request.received = now_ms();
+        std::lock_guard<std::mutex> guard(server->lock);
+        if ((int)server->queue.size() >= server->queueCapacity) {
+            server->rejected++;
+            uci_send("busy %s", id);
+        }
+        else {
+            game->searching = 1;
+            server->queue.push_back(request);
+            server->wakeup.notify_one();
+        }
+    }
+    return 1;
+}
+
+/*
+ * run_server:
+ * Serves games on stdin/stdout with `workers` search threads, each searching one request
+ * at a time with the given default limits and all sharing tt. At most queueCapacity
+ * requests wait; more are turned away with "busy". At "quit" or the end of input the
+ * queued requests are still answered, then the metrics go to stderr.
+ */
+void run_server(TranspositionTable* tt, SearchLimits limits, int disabledFeatures, int workers, int queueCapacity) {
+    static char line[65536];
+    Server* server = new Server();
+    server->tt = tt;
+    server->defaultLimits = limits;
+    server->disabledFeatures = disabledFeatures;
+    server->queueCapacity = queueCapacity;
+    server->started = now_ms();
+    std::thread* threads = new std::thread[workers];
+    for (int i = 0; i < workers; i++)
+        threads[i] = std::thread(server_worker, server);
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (!server_command(server, line))
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(server->lock);
+        server->closing = 1;
+        server->wakeup.notify_all();
+    }
+    for (int i = 0; i < workers; i++)
+        threads[i].join();
+    delete[] threads;
+    char report[512];
+    server_report(server, report, sizeof(report));
+    fprintf(stderr, "%s\n", report);
+    for (int bucket = 0; bucket < SERVER_GAME_BUCKETS; bucket++) {
+        while (server->buckets[bucket]) {
+            ServerGame* game = server->buckets[bucket];
+            server->buckets[bucket] = game->next;
+            delete game;
+        }
+    }
+    delete server;
+}
+
+// Writes the table back to its file, if it has one, when the program ends.
+static void release_trans_table() {
+    tt_release(&transTable);
+}
+
+/*
+ * main:
+ * The main game loop. The human (White) inputs moves in coordinate notation,
+ * and the AI (Black) now uses a minimax search to choose its move.
+ *
+ * For castling, enter:
+ *   - Kingside as "e1g1" (for White) or "e8g8" (for Black)
+ *   - Queenside as "e1c1" or "e8c8"
+ *
+ * Options: --hash <MB>, --threads <n>, --movetime <ms>, --depth <n>, --nodes <n>,
+ * --perft-hash <MB>, and --no-pvs, --no-null-move, --no-lmr and --no-check-extension to
+ * switch off search techniques when benchmarking them. After each search a summary of the
+ * search counters is printed; --stats-json <file> also appends them, per ply, as JSON lines.
+ * With --ponder the AI keeps thinking while the human chooses a move, on the assumption
+ * that they play the reply from its principal variation.
+ *
+ * "match <openings>" plays two configurations against each other instead, set with
+ * --engine-a and --engine-b (see parse_engine_config), for up to --games games on
+ * --concurrency workers, stopping early once the SPRT for --elo0/--elo1 decides.
+ *
+ * --tt-file <file> keeps the transposition table in a memory-mapped file, so the next
+ * run (game, uci or analyse, whose workers then share it) starts with it warm. Only a
+ * missing or empty file is turned into a new table; --tt-recreate also replaces a table
+ * file written by an incompatible build. "ttinfo <file>" reports how full and how old
+ * its contents are.
+ * "bench [depth]" runs the fixed-depth benchmark instead of a game, and
+ * "perft <depth> [fen]" counts the move tree from the start position or the FEN.
+ * "uci" (as an argument or as the first input line) switches to the UCI protocol.
+ * --book <file.bin> plays from a Polyglot book in the game and in UCI mode, and
+ * --book-best picks the highest-weight move instead of a weighted random one.
+ * "analyse <file>" scores every EPD/FEN line of the file (--depth, --nodes and --movetime
+ * set the budget, depth 6 if none is given; --threads sets the number of workers).
+ * "serve" hosts many games at once over stdin/stdout (see server_command), searching on
+ * --threads workers with at most --queue requests waiting; --depth, --nodes and
+ * --movetime set the budget of requests that do not give one.
+ */
+int main(int argc, char* argv[]) {
+    init_attack_tables();
+    init_eval_tables();
+    init_kpk_bitbase();
+    init_search_tables();
+    srand(time(NULL));
+
+    // The AI gets a fixed time per move; --depth and --nodes add optional caps.
+    static SearchInfo search;
+    size_t hashMB = DEFAULT_HASH_MB;
+    size_t perftHashMB = 0;
+    int moveTimeGiven = 0;
+    const char* bookPath = NULL;
+    int ponderEnabled = 0;
+    const char* ttFilePath = NULL;
+    int ttRecreate = 0;
+    const char* engineSettings[2] = { "", "" };
+    int matchGames = MATCH_DEFAULT_GAMES;
+    int concurrency = (int)std::thread::hardware_concurrency();
+    double elo0 = 0.0, elo1 = 5.0;
+    int serverQueue = SERVER_DEFAULT_QUEUE;
+    search.limits.maxDepth = 0;
+    search.limits.maxNodes = 0;
+    search.limits.moveTimeMs = 1000;
+    search.threads = 1;
+    const char* command = NULL;
+    int commandArg = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--hash") && i + 1 < argc)
+            hashMB = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            search.threads = atoi(argv[++i]) > 0 ? atoi(argv[i]) : 1;
+        else if (!strcmp(argv[i], "--depth") && i + 1 < argc)
+            search.limits.maxDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--nodes") && i + 1 < argc)
+            search.limits.maxNodes = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--movetime") && i + 1 < argc) {
+            search.limits.moveTimeMs = atoll(argv[++i]);
+            moveTimeGiven = 1;
+        }
+        else if (!strcmp(argv[i], "--book") && i + 1 < argc)
+            bookPath = argv[++i];
+        else if (!strcmp(argv[i], "--no-pvs"))
+            search.disabledFeatures |= FEATURE_PVS;
+        else if (!strcmp(argv[i], "--no-null-move"))
+            search.disabledFeatures |= FEATURE_NULL_MOVE;
+        else if (!strcmp(argv[i], "--no-lmr"))
+            search.disabledFeatures |= FEATURE_LMR;
+        else if (!strcmp(argv[i], "--no-check-extension"))
+            search.disabledFeatures |= FEATURE_CHECK_EXTENSION;
+        else if (!strcmp(argv[i], "--stats-json") && i + 1 < argc) {
+            statsJsonFile = fopen(argv[++i], "a");
+            if (!statsJsonFile)
+                printf("Could not open %s for the search statistics.\n", argv[i]);
+        }
+        else if (!strcmp(argv[i], "--engine-a") && i + 1 < argc)
+            engineSettings[0] = argv[++i];
+        else if (!strcmp(argv[i], "--engine-b") && i + 1 < argc)
+            engineSettings[1] = argv[++i];
+        else if (!strcmp(argv[i], "--games") && i + 1 < argc)
+            matchGames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--concurrency") && i + 1 < argc)
+            concurrency = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--elo0") && i + 1 < argc)
+            elo0 = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--elo1") && i + 1 < argc)
+            elo1 = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--queue") && i + 1 < argc)
+            serverQueue = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--tt-file") && i + 1 < argc)
+            ttFilePath = argv[++i];
+        else if (!strcmp(argv[i], "--tt-recreate"))
+            ttRecreate = 1;
+        else if (!strcmp(argv[i], "--ponder"))
+            ponderEnabled = 1;
+        else if (!strcmp(argv[i], "--book-best"))
+            openingBook.pickBest = 1;
+        else if (!strcmp(argv[i], "--perft-hash") && i + 1 < argc)
+            perftHashMB = (size_t)atoi(argv[++i]);
+        else if (!command) {
+            command = argv[i];
+            commandArg = i + 1;
+        }
+    }
+    if (command && !strcmp(command, "ttinfo")) {
+        if (commandArg >= argc) {
+            printf("Usage: ttinfo <file>\n");
+            return 1;
+        }
+        return tt_file_report(argv[commandArg]) ? 0 : 1;
+    }
+
+    search.tt = &transTable;
+    if (!tt_resize(&transTable, hashMB)) {
+        printf("Could not allocate a %d MB transposition table.\n", (int)hashMB);
+        return 1;
+    }
+    if (ttFilePath) {
+        int warm;
+        if (!tt_open_file(&transTable, ttFilePath, hashMB, ttRecreate, &warm))
+            return 1;
+        atexit(release_trans_table);
+        fprintf(stderr, "%s transposition table %s (%d MB)\n", warm ? "Reusing" : "Created", ttFilePath,
+            (int)(transTable.bucketCount * sizeof(TTBucket) / (1024 * 1024)));
+    }
+
+    if (bookPath && !book_open(&openingBook, bookPath))
+        printf("Could not open the opening book %s.\n", bookPath);
+
+    if (command && !strcmp(command, "bench")) {
+        run_bench(&search, commandArg < argc ? atoi(argv[commandArg]) : 8);
+        return 0;
+    }
+    if (command && !strcmp(command, "perft")) {
+        // The FEN may be passed as one quoted argument or as its separate fields.
+        static Position root;
+        char fen[256] = "";
+        for (int i = commandArg + 1; i < argc; i++) {
+            strncat(fen, argv[i], sizeof(fen) - strlen(fen) - 2);
+            strcat(fen, " ");
+        }
+        if (!fen[0])
+            initialize_board(&root);
+        else if (!load_fen(&root, fen)) {
+            printf("Invalid FEN: %s\n", fen);
+            return 1;
+        }
+        if (!perft_hash_resize(&perftTable, perftHashMB)) {
+            printf("Could not allocate a %d MB perft hash.\n", (int)perftHashMB);
+            return 1;
+        }
+        run_perft(&root, commandArg < argc ? atoi(argv[commandArg]) : 5, search.threads);
+        return 0;
+    }
+
+    if (command && !strcmp(command, "analyse")) {
+        if (commandArg >= argc) {
+            printf("Usage: analyse <file|-> [--depth n] [--nodes n] [--movetime ms] [--threads n]\n");
+            return 1;
+        }
+        SearchLimits limits = search.limits;
+        if (!moveTimeGiven)
+            limits.moveTimeMs = 0;
+        if (!limits.maxDepth && !limits.maxNodes && !limits.moveTimeMs)
+            limits.maxDepth = 6;
+        return run_analysis(argv[commandArg], limits, search.disabledFeatures, search.threads, hashMB,
+            ttFilePath ? &transTable : NULL) ? 0 : 1;
+    }
+    if (command && !strcmp(command, "match")) {
+        if (commandArg >= argc) {
+            printf("Usage: match <openings> [--engine-a settings] [--engine-b settings] [--games n] "
+                "[--concurrency n] [--elo0 e] [--elo1 e]\n");
+            return 1;
+        }
+        // Both engines start from the command line's settings, at MATCH_DEFAULT_MOVETIME
+        // per move unless a limit was given.
+        EngineConfig engines[2];
+        for (int engine = 0; engine < 2; engine++) {
+            EngineConfig* config = &engines[engine];
+            snprintf(config->name, sizeof(config->name), "default");
+            config->limits = search.limits;
+            if (!moveTimeGiven)
+                config->limits.moveTimeMs = (config->limits.maxDepth || config->limits.maxNodes) ? 0 : MATCH_DEFAULT_MOVETIME;
+            config->disabledFeatures = search.disabledFeatures;
+            config->hashMB = hashMB;
+            if (!parse_engine_config(engineSettings[engine], config)) {
+                printf("Invalid settings for engine %c: %s\n", 'A' + engine, engineSettings[engine]);
+                return 1;
+            }
+        }
+        return run_match(argv[commandArg], engines, matchGames, concurrency > 0 ? concurrency : 1, elo0, elo1) ? 0 : 1;
+    }
+    if (command && !strcmp(command, "serve")) {
+        run_server(&transTable, search.limits, search.disabledFeatures, search.threads,
+            serverQueue > 0 ? serverQueue : 1);
+        return 0;
+    }
+    if (command && !strcmp(command, "uci")) {
+        uci_loop(&search);
+        return 0;
+    }
+
+    static Position game;
+    initialize_board(&game);
+
+    // Pondering: after its move the AI searches the position after the reply it expects,
+    // on search, while the human thinks. ponderHit means that reply was played.
+    static Position ponderPosition;
+    std::thread ponderThread;
+    ChessMove ponderPrediction;
+    int ponderHit = 0;
+
+    while (1) {
+        display_board(&game);
+        ChessMove legalMoves[MAX_LEGAL_MOVES];
+        int numLegal = generateLegalMoves(&game, legalMoves);
+        if (numLegal == 0) {
+            if (isKingInCheck(&game.board, game.sideToMove))
+                printf("%s is checkmated. %s wins!\n",
+                    (game.sideToMove == SIDE_WHITE ? "White" : "Black"),
+                    (game.sideToMove == SIDE_WHITE ? "Black" : "White"));
+            else
+                printf("Stalemate!\n");
+            break;
+        }
+        if (game.halfmoveClock >= FIFTY_MOVE_PLIES) {
+            printf("Draw by the fifty-move rule.\n");
+            break;
+        }
+        if (is_repetition(&game, 2)) {
+            printf("Draw by threefold repetition.\n");
+            break;
+        }
+        if (game.sideToMove == SIDE_WHITE) {
+            // Human move.
+            printf("Enter your move (e.g., e2e4): ");
+            char inputStr[10];
+            if (!fgets(inputStr, sizeof(inputStr), stdin))
+                break;
+            inputStr[strcspn(inputStr, "\r\n")] = 0;
+            if (!strcmp(inputStr, "uci") && game.fullmoveNumber == 1) {
+                uci_loop(&search);
+                break;
+            }
+            ChessMove playerMove;
+            if (!interpret_move(&game, inputStr, &playerMove)) {
+                printf("Invalid move format.\n");
+                continue;
+            }
+            int valid = 0;
+            for (int i = 0; i < numLegal; i++) {
+                if (legalMoves[i].src_row == playerMove.src_row &&
+                    legalMoves[i].src_col == playerMove.src_col &&
+                    legalMoves[i].dst_row == playerMove.dst_row &&
+                    legalMoves[i].dst_col == playerMove.dst_col &&
+                    legalMoves[i].promoteTo == playerMove.promoteTo) {
+                    valid = 1;
+                    break;
+                }
+            }
+            if (!valid) {
+                printf("Illegal move. Try again.\n");
+                continue;
+            }
+            if (ponderThread.joinable()) {
+                // On a miss the ponder search is abandoned; what it stored in the table stays.
+                if (same_move(playerMove, ponderPrediction)) {
+                    ponder_hit(&search);
+                    ponderHit = 1;
+                }
+                else {
+                    search.stopRequested.store(1);
+                    ponderThread.join();
+                    search.stopRequested.store(0);
+                    search.pondering.store(0);
+                }
+            }
+            make_game_move(&game, playerMove);
+        }
+        else {
+            // AI move, from the book while the game is still in it, or from the ponder
+            // search if the human played the expected reply.
+            ChessMove aiMove;
+            int searched = 0;
+            if (ponderHit) {
+                ponderThread.join();
+                ponderHit = 0;
+                aiMove = search.bestMove;
+                searched = 1;
+            }
+            else if (book_move(&openingBook, &game, &aiMove)) {
+                printf("AI plays: ");
+                output_move(aiMove);
+                printf("  (book)\n");
+            }
+            else {
+                aiMove = choose_best_move(&game, &search);
+                searched = 1;
+            }
+            if (searched) {
+                long long elapsed = now_ms() - search.startTime;
+                char summary[512];
+                format_search_stats(summary, sizeof(summary), &search.stats, elapsed);
+                printf("AI plays: ");
+                output_move(aiMove);
+                printf("  (depth %d, score %d, %lldms after your move)\n  %s\n", search.completedDepth,
+                    search.bestScore, now_ms() - search.limitsStart.load(), summary);
+                if (statsJsonFile)
+                    write_search_stats_json(statsJsonFile, &search.stats, search.completedDepth, search.bestScore, elapsed);
+            }
+            int predicted = ponderEnabled && searched && ponder_move(&game, &search, &ponderPrediction);
+            make_game_move(&game, aiMove);
+            if (predicted) {
+                ponderPosition = game;
+                make_game_move(&ponderPosition, ponderPrediction);
+                search.pondering.store(1);
+                ponderThread = std::thread(choose_best_move, &ponderPosition, &search);
+            }
+        }
+    }
+    if (ponderThread.joinable()) {
+        search.stopRequested.store(1);
+        ponderThread.join();
+    }
+    return 0;
+}